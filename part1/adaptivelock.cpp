@@ -0,0 +1,109 @@
+#include <iostream>
+#include <cstdlib>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+int NUM_THREADS;
+
+adaptive_lock_t adaptive;
+tatas_lock_t flag = 0;
+
+//starting backoff of the static tatas lock; 0 selects the adaptive lock
+int static_delay;
+
+void static_acquire(tatas_lock_t *L)
+{
+	int b = static_delay;
+	while (tas(L))
+		backoff(&b);
+}
+
+void *run_thread(void *)
+{
+	int i;
+	for(i = 1; i <= iterations; i++) {
+		if(static_delay == 0) {
+			adaptive_acquire(&adaptive);
+			counter++;
+			adaptive_release(&adaptive);
+		}
+		else {
+			static_acquire(&flag);
+			counter++;
+			tatas_release(&flag);
+		}
+	}
+	pthread_exit(NULL);
+}
+
+//time NUM_THREADS threads incrementing the counter under one lock setting
+double run_setting(int delay)
+{
+	pthread_t threads[NUM_THREADS];
+	int rc;
+	int i;
+	void *status;
+
+	static_delay = delay;
+	counter = 0;
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+	return end - start;
+}
+
+int main(int argc, char* argv[])
+{
+	adaptive_init(&adaptive);
+
+	//default values for number of threads & iterations
+	NUM_THREADS = 4;
+	iterations  = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+
+	//a sweep of static backoff settings, then the self-tuning lock
+	int delays[] = { 4, 16, 64, 256, 1024 };
+	for(unsigned i = 0; i < sizeof(delays) / sizeof(delays[0]); i++)
+		cout << "static backoff " << delays[i] << " : Execution time ="
+		     << run_setting(delays[i]) << " nsec\n";
+	cout << "adaptive backoff : Execution time =" << run_setting(0)
+	     << " nsec, settled delay = " << adaptive.delay << endl;
+	cout << "Counter = " << counter << endl;
+	pthread_exit(NULL);
+}
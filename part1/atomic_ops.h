@@ -278,6 +278,72 @@ mvx(const volatile unsigned long long *src, volatile unsigned long long *dest)
     *destd = *srcd;
 }
 
+#elif defined(__x86_64__) && defined(__GNUC__)
+
+/* "compiler fence" for preventing reordering of loads/stores to
+   non-volatiles */
+#define CFENCE          asm volatile ("":::"memory")
+#define WBR             asm volatile("mfence":::"memory")
+#define ISYNC
+#define LWSYNC
+#define SYNC
+
+// gcc x86-64 CAS and TAS; unsigned long is 64 bits here
+
+static inline unsigned long
+cas(volatile unsigned long* ptr, unsigned long old, unsigned long _new)
+{
+    unsigned long prev;
+    asm volatile("lock;"
+                 "cmpxchgq %1, %2;"
+                 : "=a"(prev)
+                 : "q"(_new), "m"(*ptr), "a"(old)
+                 : "memory");
+    return prev;
+}
+
+static inline unsigned long tas(volatile unsigned long* ptr)
+{
+    unsigned long result;
+    asm volatile("lock;"
+                 "xchgq %0, %1;"
+                 : "=r"(result), "=m"(*ptr)
+                 : "0"(1), "m"(*ptr)
+                 : "memory");
+    return result;
+}
+
+static inline unsigned long
+swap(volatile unsigned long* ptr, unsigned long val)
+{
+    asm volatile("lock;"
+                 "xchgq %0, %1"
+                 : "=r"(val), "=m"(*ptr)
+                 : "0"(val), "m"(*ptr)
+                 : "memory");
+    return val;
+}
+
+static inline void nop()
+{
+    asm volatile("nop");
+}
+
+// a 64-bit word is a single word here, so casX is a plain cmpxchgq
+static inline bool casX(volatile unsigned long long* addr,
+                        const unsigned long long *oldVal,
+                        const unsigned long long *newVal)
+{
+    return cas((volatile unsigned long*)addr, *oldVal, *newVal) == *oldVal;
+}
+
+// atomic load and store of *src into *dest
+static inline void
+mvx(const volatile unsigned long long *src, volatile unsigned long long *dest)
+{
+    *dest = *src;
+}
+
 #elif defined(__ia64__) && defined(__GNUC__)
 /* "compiler fence" for preventing reordering of loads/stores to
    non-volatiles */
@@ -579,6 +645,64 @@ static inline void spin128()
         nop();
 }
 
+// per-thread state is padded out to a cache line so that neighbouring
+// threads do not false-share
+#define CACHELINE_BYTES 64
+
+// upper bound on the number of threads that may use the per-thread slots
+// in the structures below
+#define MAX_THREADS 128
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// give up the processor, for waiters that should not keep spinning
+#if defined(_MSC_VER)
+#include <windows.h>
+static inline void os_yield() { SwitchToThread(); }
+#else
+#include <sched.h>
+static inline void os_yield() { sched_yield(); }
+#endif
+
+// 32-bit CAS and add, for lock words and futexes that stay 4 bytes wide
+// even where unsigned long is not
+static inline int cas32(volatile int* ptr, int old, int _new)
+{
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange((volatile long*)ptr, _new, old);
+#else
+    return __sync_val_compare_and_swap(ptr, old, _new);
+#endif
+}
+
+static inline int faa32(volatile int* ptr, int amnt)
+{
+    int found = *ptr;
+    int expected;
+    do {
+        expected = found;
+    } while ((found = cas32(ptr, expected, expected + amnt)) != expected);
+    return found;
+}
+
+////////////////////////////////////////
+// dense thread indices
+
+static volatile unsigned long thread_count = 0;
+static THREAD_LOCAL long my_thread_index = -1;
+
+// index in [0, thread_count) handed out the first time a thread asks
+static inline long thread_index()
+{
+    if (my_thread_index < 0)
+        my_thread_index = fai(&thread_count);
+    return my_thread_index;
+}
+
 ////////////////////////////////////////
 // tatas lock
 
@@ -608,6 +732,188 @@ static inline void tatas_release(tatas_lock_t* L)
   *L = 0;
 }
 
+////////////////////////////////////////
+// adaptive tatas lock
+//
+// tatas whose backoff window is tuned per lock instead of fixed.  Every
+// ADAPTIVE_WINDOW acquires the holder compares failed tas attempts with
+// acquires: if waiters keep colliding the starting delay doubles, if they
+// hardly ever collide it halves.
+
+#define ADAPTIVE_WINDOW 64
+#define ADAPTIVE_MIN_DELAY 4
+#define ADAPTIVE_MAX_DELAY 65536
+// one acquire's exponential backoff stops growing at this multiple of delay
+#define ADAPTIVE_CAP_FACTOR 64
+
+extern "C"
+{
+    typedef struct
+    {
+        tatas_lock_t lock;
+        volatile int delay;
+        // only touched by the lock holder
+        int acquires;
+        int failures;
+    } adaptive_lock_t;
+}
+
+static inline void adaptive_init(adaptive_lock_t* L)
+{
+    L->lock = 0;
+    L->delay = 64;
+    L->acquires = 0;
+    L->failures = 0;
+}
+
+static inline int adaptive_acquire_slowpath(adaptive_lock_t* L)
+{
+    int b = L->delay;
+    int cap = b * ADAPTIVE_CAP_FACTOR;
+    int failures = 1;
+
+    for (;;) {
+        for (int i = b; i; i--)
+            nop();
+        if (b < cap)
+            b <<= 1;
+        if (L->lock == 0 && !tas(&L->lock))
+            return failures;
+        failures++;
+    }
+}
+
+static inline void adaptive_acquire(adaptive_lock_t* L)
+{
+    int failures = 0;
+    if (tas(&L->lock))
+        failures = adaptive_acquire_slowpath(L);
+    ISYNC;
+
+    L->failures += failures;
+    if (++L->acquires == ADAPTIVE_WINDOW) {
+        if (L->failures > L->acquires && L->delay < ADAPTIVE_MAX_DELAY)
+            L->delay <<= 1;
+        else if (L->failures < L->acquires / 4 && L->delay > ADAPTIVE_MIN_DELAY)
+            L->delay >>= 1;
+        L->acquires = 0;
+        L->failures = 0;
+    }
+}
+
+static inline void adaptive_release(adaptive_lock_t* L)
+{
+    tatas_release(&L->lock);
+}
+
+////////////////////////////////////////
+// biased lock
+//
+// A tatas lock biased toward the first thread that takes it.  The bias
+// holder enters with plain stores: it raises owner_in and checks that the
+// bias is not revoked.  Any other thread takes the tatas lock, revokes the
+// bias for the length of its critical section only, and waits for the
+// holder to leave; releasing hands the bias back.  The store-load ordering
+// this needs on the holder's side is supplied either by a fence on the
+// holder's fast path or, with sys_membarrier, by the revoking thread alone.
+// While the bias is revoked the holder queues on the tatas lock as well.
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#endif
+
+static bool bias_use_membarrier = false;
+
+// switch biased locks to membarrier-based revocation; false if unsupported
+static inline bool biased_enable_membarrier()
+{
+#if defined(__linux__) && defined(__NR_membarrier)
+    if (syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0)
+        bias_use_membarrier = true;
+#endif
+    return bias_use_membarrier;
+}
+
+// make every thread's earlier stores visible to the caller
+static inline void bias_remote_fence()
+{
+#if defined(__linux__) && defined(__NR_membarrier)
+    if (bias_use_membarrier) {
+        syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+        return;
+    }
+#endif
+    WBR;
+}
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile unsigned long holder;   // thread index + 1 of the bias holder
+        volatile unsigned long revoked;  // set while another thread holds it
+        volatile unsigned long owner_in; // holder is inside via the fast path
+        tatas_lock_t lock;
+        unsigned long revocations;       // written under lock only
+    } biased_lock_t;
+}
+
+static inline void biased_init(biased_lock_t* L)
+{
+    L->holder = 0;
+    L->revoked = 0;
+    L->owner_in = 0;
+    L->lock = 0;
+    L->revocations = 0;
+}
+
+static inline void biased_acquire(biased_lock_t* L)
+{
+    unsigned long me = thread_index() + 1;
+
+    if (L->holder == 0)
+        bool_cas(&L->holder, 0, me);
+
+    if (L->holder == me) {
+        L->owner_in = 1;
+        if (bias_use_membarrier)
+            CFENCE;
+        else
+            WBR;
+        if (!L->revoked) {
+            ISYNC;
+            return;
+        }
+        L->owner_in = 0;
+        // the revoker holds the tatas lock until it gives the bias back
+        tatas_acquire(&L->lock);
+        return;
+    }
+
+    tatas_acquire(&L->lock);
+    L->revoked = 1;
+    L->revocations++;
+    bias_remote_fence();
+    while (L->owner_in) { } // spin
+}
+
+static inline void biased_release(biased_lock_t* L)
+{
+    if (L->owner_in && L->holder == (unsigned long)thread_index() + 1) {
+        CFENCE;
+        LWSYNC;
+        L->owner_in = 0;
+        return;
+    }
+    // only the tatas holder writes revoked, so the holder's own slow path
+    // may clear it too
+    LWSYNC;
+    L->revoked = 0;
+    tatas_release(&L->lock);
+}
+
 ////////////////////////////////////////
 // ticket lock
 
@@ -666,4 +972,2420 @@ static inline void mcs_release(mcs_qnode_t** L, mcs_qnode_t* I)
     I->next->flag = false;
 }
 
+////////////////////////////////////////
+// Malthusian (concurrency restricting) MCS lock
+//
+// MCS, except that at release time a waiter with a successor of its own is
+// surplus: it is cut out of the queue and parked on a passive list, leaving
+// just the owner and one successor circulating.  Passive waiters come back
+// when the queue runs dry, and one is promoted every MCSCR_FAIRNESS
+// releases so that none of them starves.
+
+// a waiter yields the processor after this many polls of its flag
+#define MCSCR_SPIN_LIMIT 1024
+#define MCSCR_FAIRNESS 256
+
+extern "C"
+{
+    typedef struct
+    {
+        mcs_qnode_t* tail;
+        // passive list, FIFO through the nodes' next fields; holder only
+        mcs_qnode_t* passive_head;
+        mcs_qnode_t* passive_tail;
+        unsigned long releases;
+        unsigned long culled;
+    } mcscr_lock_t;
+}
+
+static inline void mcscr_init(mcscr_lock_t* L)
+{
+    L->tail = 0;
+    L->passive_head = L->passive_tail = 0;
+    L->releases = 0;
+    L->culled = 0;
+}
+
+static inline void mcscr_acquire(mcscr_lock_t* L, mcs_qnode_t* I)
+{
+    I->next = 0;
+    I->flag = true;
+    mcs_qnode_t* pred =
+        (mcs_qnode_t*)swap((volatile unsigned long*)&L->tail, (unsigned long)I);
+
+    if (pred != 0) {
+        pred->next = I;
+        int spins = 0;
+        while (I->flag) {
+            if (++spins == MCSCR_SPIN_LIMIT) {
+                os_yield();
+                spins = 0;
+            }
+        }
+    }
+    ISYNC;
+}
+
+static inline void mcscr_park(mcscr_lock_t* L, mcs_qnode_t* n)
+{
+    n->next = 0;
+    if (L->passive_tail)
+        L->passive_tail->next = n;
+    else
+        L->passive_head = n;
+    L->passive_tail = n;
+    L->culled++;
+}
+
+static inline mcs_qnode_t* mcscr_unpark(mcscr_lock_t* L)
+{
+    mcs_qnode_t* n = L->passive_head;
+    if (n) {
+        L->passive_head = n->next;
+        if (L->passive_head == 0)
+            L->passive_tail = 0;
+    }
+    return n;
+}
+
+static inline void mcscr_release(mcscr_lock_t* L, mcs_qnode_t* I)
+{
+    LWSYNC;
+    L->releases++;
+    mcs_qnode_t* succ = I->next;
+
+    if (succ == 0) {
+        // nobody visible in the queue: hand the lock to a passive waiter
+        mcs_qnode_t* p = mcscr_unpark(L);
+        if (p != 0) {
+            p->next = 0;
+            if (bool_cas((volatile unsigned long*)&L->tail,
+                         (unsigned long)I, (unsigned long)p)) {
+                p->flag = false;
+                return;
+            }
+            // someone just queued behind us: p goes back to the front
+            p->next = L->passive_head;
+            L->passive_head = p;
+            if (L->passive_tail == 0)
+                L->passive_tail = p;
+        }
+        else if (bool_cas((volatile unsigned long*)&L->tail, (unsigned long)I, 0))
+            return;
+        while ((succ = I->next) == 0) { } // spin
+    }
+
+    // succ is surplus if someone is already queued behind it
+    mcs_qnode_t* after = succ->next;
+    if (after != 0) {
+        mcscr_park(L, succ);
+        succ = after;
+    }
+
+    // long-term fairness: let the oldest passive waiter go first
+    if (L->releases % MCSCR_FAIRNESS == 0 && L->passive_head != 0) {
+        mcs_qnode_t* p = mcscr_unpark(L);
+        p->next = succ;
+        succ = p;
+    }
+    succ->flag = false;
+}
+
+////////////////////////////////////////
+// priority-class queue lock
+//
+// Waiters queue FIFO within their class and the lock is handed to the
+// oldest waiter of the highest class (0 is highest).  Each time a class
+// with waiters is passed over its bypass count goes up; at
+// PRIO_STARVATION_LIMIT that class is served next regardless.  The queues
+// themselves are guarded by a small internal tatas lock.
+
+#define PRIO_CLASSES 2
+#define PRIO_STARVATION_LIMIT 64
+
+extern "C"
+{
+    typedef volatile struct _prio_qnode_t
+    {
+        bool flag;
+        volatile struct _prio_qnode_t* next;
+    } prio_qnode_t;
+
+    typedef struct
+    {
+        tatas_lock_t guard;
+        bool held;
+        prio_qnode_t* head[PRIO_CLASSES];
+        prio_qnode_t* tail[PRIO_CLASSES];
+        int bypassed[PRIO_CLASSES];
+    } prio_lock_t;
+}
+
+static inline void prio_init(prio_lock_t* L)
+{
+    L->guard = 0;
+    L->held = false;
+    for (int c = 0; c < PRIO_CLASSES; c++) {
+        L->head[c] = L->tail[c] = 0;
+        L->bypassed[c] = 0;
+    }
+}
+
+static inline void prio_acquire(prio_lock_t* L, prio_qnode_t* I, int cls)
+{
+    tatas_acquire(&L->guard);
+    if (!L->held) {
+        L->held = true;
+        tatas_release(&L->guard);
+        return;
+    }
+
+    I->flag = true;
+    I->next = 0;
+    if (L->tail[cls])
+        L->tail[cls]->next = I;
+    else
+        L->head[cls] = I;
+    L->tail[cls] = I;
+    tatas_release(&L->guard);
+
+    while (I->flag) { } // spin
+    ISYNC;
+}
+
+static inline void prio_release(prio_lock_t* L)
+{
+    LWSYNC;
+    tatas_acquire(&L->guard);
+
+    // a starving class goes first, otherwise the highest waiting class
+    int next = -1;
+    for (int c = PRIO_CLASSES - 1; c >= 0; c--)
+        if (L->head[c] && L->bypassed[c] >= PRIO_STARVATION_LIMIT)
+            next = c;
+    if (next < 0)
+        for (int c = PRIO_CLASSES - 1; c >= 0; c--)
+            if (L->head[c])
+                next = c;
+
+    if (next < 0) {
+        L->held = false;
+        tatas_release(&L->guard);
+        return;
+    }
+
+    for (int c = 0; c < PRIO_CLASSES; c++)
+        if (c != next && L->head[c])
+            L->bypassed[c]++;
+    L->bypassed[next] = 0;
+
+    prio_qnode_t* succ = L->head[next];
+    L->head[next] = succ->next;
+    if (L->head[next] == 0)
+        L->tail[next] = 0;
+    tatas_release(&L->guard);
+
+    succ->flag = false; // lock passes straight to succ
+}
+
+////////////////////////////////////////
+// K42 MCS lock
+//
+// MCS without a caller-supplied qnode.  The lock is itself a qnode that
+// stands in for the holder, so a thread only needs its own node while it
+// waits; one thread-local node therefore serves every lock it takes.
+
+extern "C"
+{
+    typedef volatile struct _k42_qnode_t
+    {
+        volatile struct _k42_qnode_t* tail;
+        volatile struct _k42_qnode_t* next;
+    } k42_qnode_t;
+}
+
+typedef k42_qnode_t k42_lock_t;
+
+// a waiting node's tail field holds this until it is granted the lock
+#define K42_WAITING ((k42_qnode_t*)1)
+
+static THREAD_LOCAL k42_qnode_t k42_node;
+
+static inline void k42_init(k42_lock_t* L)
+{
+    L->tail = 0;
+    L->next = 0;
+}
+
+static inline void k42_acquire(k42_lock_t* L)
+{
+    for (;;) {
+        k42_qnode_t* prev = L->tail;
+        if (prev == 0) {
+            // lock is free: the lock's own node marks us as holder
+            if (bool_cas((volatile unsigned long*)&L->tail, 0, (unsigned long)L))
+                break;
+        }
+        else {
+            k42_qnode_t* I = &k42_node;
+            I->tail = K42_WAITING;
+            I->next = 0;
+            if (bool_cas((volatile unsigned long*)&L->tail,
+                         (unsigned long)prev, (unsigned long)I)) {
+                prev->next = I;
+                while (I->tail == K42_WAITING) { } // spin
+
+                // move our successor into the lock so I can be reused
+                k42_qnode_t* succ = I->next;
+                if (succ == 0) {
+                    L->next = 0;
+                    if (!bool_cas((volatile unsigned long*)&L->tail,
+                                  (unsigned long)I, (unsigned long)L)) {
+                        while ((succ = I->next) == 0) { } // spin
+                        L->next = succ;
+                    }
+                }
+                else
+                    L->next = succ;
+                break;
+            }
+        }
+    }
+    ISYNC;
+}
+
+static inline void k42_release(k42_lock_t* L)
+{
+    LWSYNC;
+    k42_qnode_t* succ = L->next;
+    if (succ == 0) {
+        if (bool_cas((volatile unsigned long*)&L->tail, (unsigned long)L, 0))
+            return;
+        while ((succ = L->next) == 0) { } // spin
+    }
+    succ->tail = 0;
+}
+
+// lock()/unlock() wrapper, usable with std::lock_guard
+struct k42_mutex
+{
+    k42_lock_t L;
+    k42_mutex() { k42_init(&L); }
+    void lock() { k42_acquire(&L); }
+    void unlock() { k42_release(&L); }
+};
+
+////////////////////////////////////////
+// reactive lock
+//
+// Runs as a tatas lock while contention is low and as a K42 queue lock
+// while it is high.  A thread is in the critical section only if it holds
+// the lock of the protocol named by mode, and mode is only changed by such
+// a holder while it also holds the other protocol's lock, so a thread that
+// wins the stale protocol just sees the new mode and retries.
+
+#define REACTIVE_TAS 0
+#define REACTIVE_QUEUE 1
+
+// contention is judged over windows of this many acquires: a window with
+// at least REACTIVE_TO_QUEUE contended tatas acquires moves the lock to the
+// queue, and one with at most REACTIVE_TO_TAS queued acquires moves it back
+#define REACTIVE_WINDOW 64
+#define REACTIVE_TO_QUEUE 16
+#define REACTIVE_TO_TAS 4
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile unsigned long mode;
+        tatas_lock_t tas;
+        k42_lock_t queue;
+        // only touched by the lock holder
+        int acquires;
+        int contended;
+        bool switch_pending;
+        unsigned long switches;
+    } reactive_lock_t;
+}
+
+static inline void reactive_init(reactive_lock_t* L)
+{
+    L->mode = REACTIVE_TAS;
+    L->tas = 0;
+    k42_init(&L->queue);
+    L->acquires = 0;
+    L->contended = 0;
+    L->switch_pending = false;
+    L->switches = 0;
+}
+
+static inline void reactive_acquire(reactive_lock_t* L)
+{
+    for (;;) {
+        bool waited;
+        if (L->mode == REACTIVE_TAS) {
+            int b = 64;
+            waited = false;
+            while (tas(&L->tas)) {
+                waited = true;
+                backoff(&b);
+            }
+            ISYNC;
+            if (L->mode != REACTIVE_TAS) {
+                tatas_release(&L->tas);
+                continue;
+            }
+        }
+        else {
+            waited = (L->queue.tail != 0);
+            k42_acquire(&L->queue);
+            if (L->mode != REACTIVE_QUEUE) {
+                k42_release(&L->queue);
+                continue;
+            }
+        }
+
+        if (waited)
+            L->contended++;
+        if (++L->acquires == REACTIVE_WINDOW) {
+            if (L->mode == REACTIVE_TAS)
+                L->switch_pending = (L->contended >= REACTIVE_TO_QUEUE);
+            else
+                L->switch_pending = (L->contended <= REACTIVE_TO_TAS);
+            L->acquires = 0;
+            L->contended = 0;
+        }
+        return;
+    }
+}
+
+static inline void reactive_release(reactive_lock_t* L)
+{
+    if (L->switch_pending) {
+        L->switch_pending = false;
+        L->switches++;
+        if (L->mode == REACTIVE_TAS) {
+            k42_acquire(&L->queue);
+            L->mode = REACTIVE_QUEUE;
+            k42_release(&L->queue);
+            tatas_release(&L->tas);
+        }
+        else {
+            tatas_acquire(&L->tas);
+            L->mode = REACTIVE_TAS;
+            tatas_release(&L->tas);
+            k42_release(&L->queue);
+        }
+        return;
+    }
+
+    if (L->mode == REACTIVE_TAS)
+        tatas_release(&L->tas);
+    else
+        k42_release(&L->queue);
+}
+
+////////////////////////////////////////
+// Hemlock
+//
+// One-word FIFO lock.  The tail names the grant word of the last thread to
+// arrive; each thread has a single grant word for all the locks it holds.
+// A releasing owner with a waiter writes the lock's address into its own
+// grant word and waits for the successor to clear it.
+
+typedef volatile unsigned long hemlock_t;
+
+static THREAD_LOCAL volatile unsigned long hem_grant = 0;
+
+static inline void hemlock_acquire(hemlock_t* L)
+{
+    volatile unsigned long* pred =
+        (volatile unsigned long*)swap(L, (unsigned long)&hem_grant);
+
+    if (pred != 0) {
+        while (*pred != (unsigned long)L) { } // spin
+        *pred = 0; // acknowledge, so pred may reuse its grant word
+    }
+    ISYNC;
+}
+
+static inline void hemlock_release(hemlock_t* L)
+{
+    LWSYNC;
+    if (bool_cas(L, (unsigned long)&hem_grant, 0))
+        return;
+    hem_grant = (unsigned long)L;
+    while (hem_grant != 0) { } // spin
+}
+
+////////////////////////////////////////
+// queued spinlock (Linux qspinlock style)
+//
+// The whole lock is one 32-bit word on every target.  The low byte
+// is the locked flag and is taken with a single CAS when the lock is free.
+// Contended acquirers queue MCS-style on per-thread nodes; the queue tail is
+// encoded in the upper bits as (thread index + 1, nesting level), so no
+// node has to be passed in by the caller.
+
+typedef volatile int qspin_lock_t;
+
+#define QS_LOCKED       1
+#define QS_LOCKED_MASK  0xff
+#define QS_IDX_SHIFT    8
+#define QS_IDX_BITS     2
+#define QS_TID_SHIFT    (QS_IDX_SHIFT + QS_IDX_BITS)
+#define QS_TAIL_MASK    (~QS_LOCKED_MASK)
+
+// a thread can be queued on this many qspinlocks at once
+#define QS_MAX_NODES    (1 << QS_IDX_BITS)
+
+extern "C"
+{
+    typedef struct _qs_node_t
+    {
+        volatile unsigned long locked;
+        volatile struct _qs_node_t* next;
+        char pad[CACHELINE_BYTES - 2 * sizeof(void*)];
+    } qs_node_t;
+}
+
+static qs_node_t qs_nodes[MAX_THREADS][QS_MAX_NODES];
+static THREAD_LOCAL int qs_depth = 0;
+
+// (MAX_THREADS << QS_TID_SHIFT) still fits well inside the 32-bit word
+static inline int qs_encode_tail(long tid, int idx)
+{
+    return ((int)(tid + 1) << QS_TID_SHIFT) | (idx << QS_IDX_SHIFT);
+}
+
+static inline qs_node_t* qs_decode_tail(int tail)
+{
+    long tid = (long)(tail >> QS_TID_SHIFT) - 1;
+    int idx = (tail >> QS_IDX_SHIFT) & (QS_MAX_NODES - 1);
+    return &qs_nodes[tid][idx];
+}
+
+static inline void qspin_acquire_slowpath(qspin_lock_t* L)
+{
+    // out of nodes: just spin for the free lock
+    if (qs_depth == QS_MAX_NODES) {
+        while (cas32(L, 0, QS_LOCKED) != 0)
+            spin64();
+        return;
+    }
+
+    int idx = qs_depth++;
+    qs_node_t* node = &qs_nodes[thread_index()][idx];
+    int tail = qs_encode_tail(thread_index(), idx);
+    node->locked = 0;
+    node->next = 0;
+
+    // publish ourselves as the new tail, leaving the locked byte alone
+    int old;
+    do {
+        old = *L;
+    } while (cas32(L, old, (old & QS_LOCKED_MASK) | tail) != old);
+
+    // wait until we are at the head of the queue
+    if (old & QS_TAIL_MASK) {
+        qs_node_t* pred = qs_decode_tail(old & QS_TAIL_MASK);
+        pred->next = node;
+        while (!node->locked) { } // spin
+    }
+
+    // the head spins on the lock word itself for the owner to leave
+    for (;;) {
+        int v = *L;
+        if (v & QS_LOCKED_MASK)
+            continue;
+        if ((v & QS_TAIL_MASK) == tail) {
+            // nobody queued behind us: clear the tail as we take the lock
+            if (cas32(L, v, QS_LOCKED) == v)
+                break;
+        }
+        else if (cas32(L, v, v | QS_LOCKED) == v) {
+            // hand the head of the queue to our successor
+            while (node->next == 0) { } // spin
+            node->next->locked = 1;
+            break;
+        }
+    }
+    qs_depth--;
+}
+
+static inline void qspin_acquire(qspin_lock_t* L)
+{
+    if (cas32(L, 0, QS_LOCKED) != 0)
+        qspin_acquire_slowpath(L);
+    ISYNC;
+}
+
+static inline void qspin_release(qspin_lock_t* L)
+{
+    LWSYNC;
+    // queued threads may be changing the tail bits concurrently
+    faa32(L, -QS_LOCKED);
+}
+
+////////////////////////////////////////
+// flat combining lock
+//
+// Instead of running its own critical section, a thread publishes it as an
+// (op, arg) pair in its slot.  Whoever wins the combiner lock runs every
+// pending request in one pass, so the protected data stays in the
+// combiner's cache.
+
+// number of sweeps over the publication slots per combining session
+#define FC_COMBINE_PASSES 3
+
+typedef void (*fc_op_t)(void* arg);
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile fc_op_t op;
+        void* volatile arg;
+        char pad[CACHELINE_BYTES - 2 * sizeof(void*)];
+    } fc_slot_t;
+
+    typedef struct
+    {
+        tatas_lock_t lock;
+        char pad[CACHELINE_BYTES - sizeof(tatas_lock_t)];
+        fc_slot_t slot[MAX_THREADS];
+    } fc_lock_t;
+}
+
+static inline void fc_init(fc_lock_t* L)
+{
+    L->lock = 0;
+    for (int i = 0; i < MAX_THREADS; i++)
+        L->slot[i].op = 0;
+}
+
+static inline void fc_combine(fc_lock_t* L)
+{
+    unsigned long n = thread_count;
+    for (int pass = 0; pass < FC_COMBINE_PASSES; pass++) {
+        for (unsigned long i = 0; i < n; i++) {
+            fc_slot_t* s = &L->slot[i];
+            fc_op_t op = s->op;
+            if (op != 0) {
+                op(s->arg);
+                CFENCE;
+                LWSYNC;
+                s->op = 0;
+            }
+        }
+    }
+}
+
+// run op(arg) in mutual exclusion with every other op on L
+static inline void fc_execute(fc_lock_t* L, fc_op_t op, void* arg)
+{
+    fc_slot_t* me = &L->slot[thread_index()];
+    me->arg = arg;
+    LWSYNC;
+    me->op = op;
+
+    while (me->op != 0) {
+        if (L->lock == 0 && !tas(&L->lock)) {
+            ISYNC;
+            fc_combine(L);
+            tatas_release(&L->lock);
+        }
+        else
+            spin64();
+    }
+    ISYNC;
+    CFENCE;
+}
+
+////////////////////////////////////////
+// delegation lock
+//
+// A dedicated server thread owns the protected data and is the only thread
+// that ever touches it.  Clients write a request into their own mailbox
+// line and spin on it until the server posts the reply.
+
+// the server yields after this many passes over the mailboxes find no
+// work, and a client after this many polls of its own mailbox, so that
+// neither starves the other when there are more threads than processors
+#define DL_SPIN_LIMIT 1024
+
+typedef unsigned long (*dl_op_t)(void* arg);
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile dl_op_t op;
+        void* volatile arg;
+        volatile unsigned long ret;
+        char pad[CACHELINE_BYTES - 3 * sizeof(void*)];
+    } dl_mailbox_t;
+
+    typedef struct
+    {
+        volatile unsigned long stop;
+        char pad[CACHELINE_BYTES - sizeof(unsigned long)];
+        dl_mailbox_t box[MAX_THREADS];
+    } dl_server_t;
+}
+
+static inline void dl_init(dl_server_t* S)
+{
+    S->stop = 0;
+    for (int i = 0; i < MAX_THREADS; i++)
+        S->box[i].op = 0;
+}
+
+// body of the server thread; returns once dl_stop() has been called
+static inline void dl_serve(dl_server_t* S)
+{
+    int idle = 0;
+    while (!S->stop) {
+        unsigned long n = thread_count;
+        bool served = false;
+        for (unsigned long i = 0; i < n; i++) {
+            dl_mailbox_t* m = &S->box[i];
+            dl_op_t op = m->op;
+            if (op != 0) {
+                m->ret = op(m->arg);
+                CFENCE;
+                LWSYNC;
+                m->op = 0;
+                served = true;
+            }
+        }
+        if (served)
+            idle = 0;
+        else if (++idle == DL_SPIN_LIMIT) {
+            os_yield();
+            idle = 0;
+        }
+    }
+}
+
+static inline void dl_stop(dl_server_t* S)
+{
+    S->stop = 1;
+}
+
+// have the server run op(arg) and return its result
+static inline unsigned long dl_execute(dl_server_t* S, dl_op_t op, void* arg)
+{
+    dl_mailbox_t* me = &S->box[thread_index()];
+    me->arg = arg;
+    LWSYNC;
+    me->op = op;
+
+    int spins = 0;
+    while (me->op != 0) {
+        if (++spins == DL_SPIN_LIMIT) {
+            os_yield();
+            spins = 0;
+        }
+    }
+    ISYNC;
+    CFENCE;
+    return me->ret;
+}
+
+////////////////////////////////////////
+// futex wait/wake
+//
+// Sleep while *addr == val, and wake up to n sleepers on addr.  Without
+// futexes the wait degenerates into a yield, so callers must loop.
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+static inline void futex_wait(volatile int* addr, int val)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+    if (*addr == val)
+        os_yield();
+#endif
+}
+
+static inline void futex_wake(volatile int* addr, int n)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+#endif
+}
+
+////////////////////////////////////////
+// parking lot
+//
+// One global hash table of wait queues keyed by address, in the style of
+// WebKit's ParkingLot.  A lock or condition only needs a couple of bits to
+// say "someone may be parked on me"; the queue itself lives here.  Each
+// bucket is guarded by a tatas lock, and the validate/callback hooks run
+// under it so that callers can update their own state atomically with
+// parking and unparking.
+
+#define PARKING_BUCKETS 256
+
+extern "C"
+{
+    typedef struct _parked_thread_t
+    {
+        const void* addr;
+        volatile int woken;
+        struct _parked_thread_t* next;
+    } parked_thread_t;
+
+    typedef struct
+    {
+        tatas_lock_t lock;
+        parked_thread_t* head;
+        parked_thread_t* tail;
+        char pad[CACHELINE_BYTES - 3 * sizeof(void*)];
+    } parking_bucket_t;
+}
+
+static parking_bucket_t parking_table[PARKING_BUCKETS];
+static THREAD_LOCAL parked_thread_t parked_self;
+
+static inline parking_bucket_t* parking_bucket(const void* addr)
+{
+    unsigned long a = (unsigned long)addr;
+    return &parking_table[((a >> 3) ^ (a >> 11)) & (PARKING_BUCKETS - 1)];
+}
+
+// park the caller on addr if validate(ctx) holds; before_sleep(ctx) runs
+// once the caller is queued.  Returns false if validation failed.
+static inline bool parking_park(const void* addr,
+                                bool (*validate)(void*),
+                                void (*before_sleep)(void*),
+                                void* ctx)
+{
+    parking_bucket_t* b = parking_bucket(addr);
+    parked_thread_t* me = &parked_self;
+
+    tatas_acquire(&b->lock);
+    if (validate && !validate(ctx)) {
+        tatas_release(&b->lock);
+        return false;
+    }
+    me->addr = addr;
+    me->woken = 0;
+    me->next = 0;
+    if (b->tail)
+        b->tail->next = me;
+    else
+        b->head = me;
+    b->tail = me;
+    tatas_release(&b->lock);
+
+    if (before_sleep)
+        before_sleep(ctx);
+    while (!me->woken)
+        futex_wait(&me->woken, 0);
+    ISYNC;
+    return true;
+}
+
+// wake the oldest thread parked on addr.  callback(ctx, did_unpark,
+// may_have_more) runs under the bucket lock before the thread is woken.
+static inline bool parking_unpark_one(const void* addr,
+                                      void (*callback)(void*, bool, bool),
+                                      void* ctx)
+{
+    parking_bucket_t* b = parking_bucket(addr);
+    parked_thread_t* found = 0;
+    bool more = false;
+
+    tatas_acquire(&b->lock);
+    parked_thread_t* prev = 0;
+    parked_thread_t* t = b->head;
+    while (t && t->addr != addr) {
+        prev = t;
+        t = t->next;
+    }
+    if (t) {
+        found = t;
+        if (prev)
+            prev->next = t->next;
+        else
+            b->head = t->next;
+        if (b->tail == t)
+            b->tail = prev;
+        for (t = t->next; t; t = t->next)
+            if (t->addr == addr) {
+                more = true;
+                break;
+            }
+    }
+    if (callback)
+        callback(ctx, found != 0, more);
+    tatas_release(&b->lock);
+
+    if (found) {
+        LWSYNC;
+        found->woken = 1;
+        futex_wake(&found->woken, 1);
+    }
+    return found != 0;
+}
+
+// wake every thread parked on addr; returns how many there were
+static inline int parking_unpark_all(const void* addr)
+{
+    parking_bucket_t* b = parking_bucket(addr);
+    parked_thread_t* woken = 0;
+    int n = 0;
+
+    tatas_acquire(&b->lock);
+    parked_thread_t** link = &b->head;
+    b->tail = 0;
+    while (*link) {
+        parked_thread_t* t = *link;
+        if (t->addr == addr) {
+            *link = t->next;
+            t->next = woken;
+            woken = t;
+            n++;
+        }
+        else {
+            b->tail = t;
+            link = &t->next;
+        }
+    }
+    tatas_release(&b->lock);
+
+    while (woken) {
+        parked_thread_t* t = woken;
+        woken = t->next;
+        LWSYNC;
+        t->woken = 1;
+        futex_wake(&t->woken, 1);
+    }
+    return n;
+}
+
+////////////////////////////////////////
+// one-byte lock and condition on the parking lot
+
+#define BYTE_LOCKED 1
+#define BYTE_PARKED 2
+
+// polls of a held lock before a thread parks
+#define BYTE_LOCK_SPINS 40
+
+typedef volatile unsigned char byte_lock_t;
+typedef volatile unsigned char byte_cond_t;
+
+static inline unsigned char
+cas8(volatile unsigned char* ptr, unsigned char old, unsigned char _new)
+{
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange8((volatile char*)ptr, _new, old);
+#else
+    return __sync_val_compare_and_swap(ptr, old, _new);
+#endif
+}
+
+static inline bool byte_lock_park_ok(void* L)
+{
+    return *(byte_lock_t*)L == (BYTE_LOCKED | BYTE_PARKED);
+}
+
+static inline void byte_lock_acquire_slowpath(byte_lock_t* L)
+{
+    int spins = 0;
+    for (;;) {
+        unsigned char v = *L;
+        if (!(v & BYTE_LOCKED)) {
+            if (cas8(L, v, v | BYTE_LOCKED) == v)
+                return;
+            continue;
+        }
+        if (!(v & BYTE_PARKED)) {
+            if (spins++ < BYTE_LOCK_SPINS) {
+                spin64();
+                continue;
+            }
+            if (cas8(L, v, v | BYTE_PARKED) != v)
+                continue;
+        }
+        parking_park((const void*)L, byte_lock_park_ok, 0, (void*)L);
+    }
+}
+
+static inline void byte_lock_acquire(byte_lock_t* L)
+{
+    if (cas8(L, 0, BYTE_LOCKED) != 0)
+        byte_lock_acquire_slowpath(L);
+    ISYNC;
+}
+
+static inline void byte_lock_unpark_cb(void* L, bool /*did_unpark*/, bool more)
+{
+    *(byte_lock_t*)L = more ? BYTE_PARKED : 0;
+}
+
+static inline void byte_lock_release(byte_lock_t* L)
+{
+    LWSYNC;
+    if (cas8(L, BYTE_LOCKED, 0) == BYTE_LOCKED)
+        return;
+    parking_unpark_one((const void*)L, byte_lock_unpark_cb, (void*)L);
+}
+
+extern "C"
+{
+    typedef struct
+    {
+        byte_cond_t* cond;
+        byte_lock_t* lock;
+    } byte_cond_wait_t;
+}
+
+static inline bool byte_cond_park_ok(void* ctx)
+{
+    *((byte_cond_wait_t*)ctx)->cond = 1;
+    return true;
+}
+
+static inline void byte_cond_before_sleep(void* ctx)
+{
+    byte_lock_release(((byte_cond_wait_t*)ctx)->lock);
+}
+
+// atomically release L and wait for a notify on C, then retake L
+static inline void byte_cond_wait(byte_cond_t* C, byte_lock_t* L)
+{
+    byte_cond_wait_t w = { C, L };
+    parking_park((const void*)C, byte_cond_park_ok, byte_cond_before_sleep, &w);
+    byte_lock_acquire(L);
+}
+
+static inline void byte_cond_unpark_cb(void* C, bool /*did_unpark*/, bool more)
+{
+    if (!more)
+        *(byte_cond_t*)C = 0;
+}
+
+static inline void byte_cond_notify_one(byte_cond_t* C)
+{
+    if (*C)
+        parking_unpark_one((const void*)C, byte_cond_unpark_cb, (void*)C);
+}
+
+static inline void byte_cond_notify_all(byte_cond_t* C)
+{
+    if (*C) {
+        *C = 0;
+        parking_unpark_all((const void*)C);
+    }
+}
+
+////////////////////////////////////////
+// futex semaphore and condition variable
+//
+// Both count their sleepers, so that post and signal stay in user space
+// when nobody is waiting, and a semaphore with a positive count is taken
+// with a single CAS.  fcond_wait works with any lock that has lock() and
+// unlock(); adapters for the header's locks are below.
+
+// polls of an empty semaphore before a thread sleeps
+#define FSEM_SPINS 100
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile int count;
+        volatile int waiters;
+    } fsem_t;
+
+    typedef struct
+    {
+        volatile int seq;
+        volatile int waiters;
+    } fcond_t;
+}
+
+static inline void fsem_init(fsem_t* S, int count)
+{
+    S->count = count;
+    S->waiters = 0;
+}
+
+static inline bool fsem_trywait(fsem_t* S)
+{
+    int c = S->count;
+    while (c > 0) {
+        int found = cas32(&S->count, c, c - 1);
+        if (found == c) {
+            ISYNC;
+            return true;
+        }
+        c = found;
+    }
+    return false;
+}
+
+static inline void fsem_wait(fsem_t* S)
+{
+    for (int i = 0; i < FSEM_SPINS; i++) {
+        if (fsem_trywait(S))
+            return;
+        spin64();
+    }
+    // the count is only slept on while it is zero, and post looks for
+    // waiters after raising it, so a post cannot be missed
+    faa32(&S->waiters, 1);
+    while (!fsem_trywait(S))
+        futex_wait(&S->count, 0);
+    faa32(&S->waiters, -1);
+}
+
+static inline void fsem_post(fsem_t* S)
+{
+    faa32(&S->count, 1);
+    if (S->waiters)
+        futex_wake(&S->count, 1);
+}
+
+static inline void fcond_init(fcond_t* C)
+{
+    C->seq = 0;
+    C->waiters = 0;
+}
+
+// release L, sleep until signalled, retake L.  Wakeups may be spurious,
+// so callers recheck their predicate.  Signals must be sent with L held.
+template <class Lock>
+static inline void fcond_wait(fcond_t* C, Lock& L)
+{
+    faa32(&C->waiters, 1);
+    int s = C->seq;
+    L.unlock();
+    futex_wait(&C->seq, s);
+    faa32(&C->waiters, -1);
+    L.lock();
+}
+
+static inline void fcond_signal(fcond_t* C)
+{
+    if (C->waiters) {
+        faa32(&C->seq, 1);
+        futex_wake(&C->seq, 1);
+    }
+}
+
+static inline void fcond_broadcast(fcond_t* C)
+{
+    if (C->waiters) {
+        faa32(&C->seq, 1);
+        futex_wake(&C->seq, 0x7fffffff);
+    }
+}
+
+struct tatas_mutex
+{
+    tatas_lock_t L;
+    tatas_mutex() : L(0) { }
+    void lock() { tatas_acquire(&L); }
+    void unlock() { tatas_release(&L); }
+};
+
+struct ticket_mutex
+{
+    ticket_lock_t L;
+    ticket_mutex() { L.next_ticket = 0; L.now_serving = 0; }
+    void lock() { ticket_acquire(&L); }
+    void unlock() { ticket_release(&L); }
+};
+
+struct byte_mutex
+{
+    byte_lock_t L;
+    byte_mutex() : L(0) { }
+    void lock() { byte_lock_acquire(&L); }
+    void unlock() { byte_lock_release(&L); }
+};
+
+// MCS wants a queue node from lock() to unlock(); the adapter takes it from
+// a small per-thread stack, so a thread may hold up to MCS_MUTEX_NODES of
+// these at once.  unlock() pops the top node, so nested locks must be
+// released strictly LIFO: unlocking an outer lock first would hand it the
+// inner lock's node.  Going deeper than the stack aborts.
+
+#include <stdlib.h>
+
+#define MCS_MUTEX_NODES 4
+static THREAD_LOCAL mcs_qnode_t mcs_mutex_node[MCS_MUTEX_NODES];
+static THREAD_LOCAL int mcs_mutex_depth = 0;
+
+struct mcs_mutex
+{
+    mcs_qnode_t* L;
+    mcs_mutex() : L(0) { }
+    void lock()
+    {
+        if (mcs_mutex_depth >= MCS_MUTEX_NODES)
+            abort();
+        mcs_acquire(&L, &mcs_mutex_node[mcs_mutex_depth++]);
+    }
+    void unlock()
+    {
+        if (mcs_mutex_depth <= 0)
+            abort();
+        mcs_release(&L, &mcs_mutex_node[--mcs_mutex_depth]);
+    }
+};
+
+////////////////////////////////////////
+// barriers
+//
+// The four barriers from Mellor-Crummey and Scott's "Algorithms for
+// Scalable Synchronization".  All are sense reversing, so they can be
+// reused back to back, and all take the caller's thread number in
+// [0, n) so that each thread spins on flags of its own where the
+// algorithm allows it.  n may be at most MAX_THREADS.
+
+#define COMBINING_FANIN 4
+#define BARRIER_ROUNDS 8          // enough for 1 << 7 == MAX_THREADS
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile unsigned long v;
+        char pad[CACHELINE_BYTES - sizeof(unsigned long)];
+    } padded_flag_t;
+
+    // centralized: one counter and one global sense
+    typedef struct
+    {
+        volatile unsigned long count;
+        volatile unsigned long sense;
+        unsigned long n;
+        char pad[CACHELINE_BYTES - 3 * sizeof(unsigned long)];
+        padded_flag_t local_sense[MAX_THREADS];
+    } central_barrier_t;
+
+    // combining tree: the last arriver at a node goes on to its parent,
+    // and releases the node's waiters on the way back down
+    typedef struct _combining_node_t
+    {
+        volatile unsigned long count;
+        volatile unsigned long sense;
+        unsigned long k;
+        struct _combining_node_t* parent;
+        char pad[CACHELINE_BYTES - 3 * sizeof(unsigned long) - sizeof(void*)];
+    } combining_node_t;
+
+    typedef struct
+    {
+        combining_node_t node[MAX_THREADS];
+        padded_flag_t local_sense[MAX_THREADS];
+    } combining_barrier_t;
+
+    // tournament: statically paired rounds; losers wait on their own wake
+    // flag, and the champion wakes the winners tree top down
+    typedef struct
+    {
+        volatile unsigned long arrive[BARRIER_ROUNDS];
+        volatile unsigned long wake;
+        unsigned long sense;
+        char pad[CACHELINE_BYTES - (BARRIER_ROUNDS + 2)
+                 * sizeof(unsigned long) % CACHELINE_BYTES];
+    } tournament_slot_t;
+
+    typedef struct
+    {
+        unsigned long n;
+        tournament_slot_t slot[MAX_THREADS];
+    } tournament_barrier_t;
+
+    // dissemination: in round k thread i signals thread i + 2^k, so
+    // everyone learns of everyone else's arrival in log n rounds
+    typedef struct
+    {
+        volatile unsigned long flag[2][BARRIER_ROUNDS];
+        unsigned long parity;
+        unsigned long sense;
+        char pad[CACHELINE_BYTES - (2 * BARRIER_ROUNDS + 2)
+                 * sizeof(unsigned long) % CACHELINE_BYTES];
+    } dissemination_slot_t;
+
+    typedef struct
+    {
+        unsigned long n;
+        unsigned long rounds;
+        dissemination_slot_t slot[MAX_THREADS];
+    } dissemination_barrier_t;
+}
+
+static inline void central_barrier_init(central_barrier_t* B, int n)
+{
+    B->count = 0;
+    B->sense = 0;
+    B->n = n;
+    for (int i = 0; i < MAX_THREADS; i++)
+        B->local_sense[i].v = 0;
+}
+
+static inline void central_barrier_wait(central_barrier_t* B, int tid)
+{
+    unsigned long s = !B->local_sense[tid].v;
+    B->local_sense[tid].v = s;
+    if (fai(&B->count) == B->n - 1) {
+        B->count = 0;
+        LWSYNC;
+        B->sense = s;
+    }
+    else
+        while (B->sense != s) { } // spin
+    ISYNC;
+}
+
+static inline void combining_barrier_init(combining_barrier_t* B, int n)
+{
+    for (int i = 0; i < MAX_THREADS; i++) {
+        B->node[i].count = 0;
+        B->node[i].sense = 0;
+        B->node[i].parent = 0;
+        B->local_sense[i].v = 0;
+    }
+    // leaves take COMBINING_FANIN threads each, inner nodes take
+    // COMBINING_FANIN nodes of the level below
+    int first = 0;
+    int below = n;
+    for (;;) {
+        int width = (below + COMBINING_FANIN - 1) / COMBINING_FANIN;
+        for (int j = 0; j < width; j++) {
+            int k = below - j * COMBINING_FANIN;
+            B->node[first + j].k = k < COMBINING_FANIN ? k : COMBINING_FANIN;
+        }
+        if (width == 1)
+            break;
+        for (int j = 0; j < width; j++)
+            B->node[first + j].parent =
+                &B->node[first + width + j / COMBINING_FANIN];
+        first += width;
+        below = width;
+    }
+}
+
+static inline void
+combining_barrier_arrive(combining_node_t* N, unsigned long s)
+{
+    if (fai(&N->count) == N->k - 1) {
+        if (N->parent)
+            combining_barrier_arrive(N->parent, s);
+        N->count = 0;
+        LWSYNC;
+        N->sense = s;
+    }
+    else
+        while (N->sense != s) { } // spin
+}
+
+static inline void combining_barrier_wait(combining_barrier_t* B, int tid)
+{
+    unsigned long s = !B->local_sense[tid].v;
+    B->local_sense[tid].v = s;
+    combining_barrier_arrive(&B->node[tid / COMBINING_FANIN], s);
+    ISYNC;
+}
+
+static inline void tournament_barrier_init(tournament_barrier_t* B, int n)
+{
+    B->n = n;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        for (int k = 0; k < BARRIER_ROUNDS; k++)
+            B->slot[i].arrive[k] = 0;
+        B->slot[i].wake = 0;
+        B->slot[i].sense = 0;
+    }
+}
+
+static inline void tournament_barrier_wait(tournament_barrier_t* B, int tid)
+{
+    tournament_slot_t* me = &B->slot[tid];
+    unsigned long s = !me->sense;
+    me->sense = s;
+
+    // play rounds until this thread loses one or wins them all
+    int k;
+    for (k = 0; (1UL << k) < B->n; k++) {
+        if (tid & (1 << k)) {
+            LWSYNC;
+            B->slot[tid - (1 << k)].arrive[k] = s;
+            while (me->wake != s) { } // spin
+            break;
+        }
+        if (tid + (1UL << k) < B->n)
+            while (me->arrive[k] != s) { } // spin
+    }
+
+    // wake the threads this one beat, latest round first
+    LWSYNC;
+    while (k-- > 0)
+        if (tid + (1UL << k) < B->n)
+            B->slot[tid + (1 << k)].wake = s;
+    ISYNC;
+}
+
+static inline void
+dissemination_barrier_init(dissemination_barrier_t* B, int n)
+{
+    B->n = n;
+    B->rounds = 0;
+    while ((1UL << B->rounds) < B->n)
+        B->rounds++;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        for (int k = 0; k < BARRIER_ROUNDS; k++)
+            B->slot[i].flag[0][k] = B->slot[i].flag[1][k] = 0;
+        B->slot[i].parity = 0;
+        B->slot[i].sense = 1;
+    }
+}
+
+static inline void
+dissemination_barrier_wait(dissemination_barrier_t* B, int tid)
+{
+    dissemination_slot_t* me = &B->slot[tid];
+    unsigned long p = me->parity;
+    unsigned long s = me->sense;
+
+    LWSYNC;
+    for (unsigned long k = 0; k < B->rounds; k++) {
+        B->slot[(tid + (1UL << k)) % B->n].flag[p][k] = s;
+        while (me->flag[p][k] != s) { } // spin
+    }
+    // the two flag sets alternate, and the sense flips every second use
+    if (p == 1)
+        me->sense = !s;
+    me->parity = 1 - p;
+    ISYNC;
+}
+
+////////////////////////////////////////
+// sharded counter
+//
+// One padded cell per thread, written only by its owner, so an increment
+// is a plain load and store on a line nobody else writes.  Each time a
+// cell crosses a multiple of SHARDED_BATCH its owner also adds the batch
+// to a shared total; that gives an O(1) approximate read which trails
+// the true count by less than SHARDED_BATCH per thread.  The exact read
+// sums the cells, and is exact once the writers are quiescent.
+
+#define SHARDED_BATCH 1024
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile unsigned long approx;
+        volatile unsigned long shards;    // 1 + highest cell in use
+        char pad[CACHELINE_BYTES - 2 * sizeof(unsigned long)];
+        padded_flag_t cell[MAX_THREADS];
+    } sharded_counter_t;
+}
+
+static inline void sharded_init(sharded_counter_t* C)
+{
+    C->approx = 0;
+    C->shards = 0;
+    for (int i = 0; i < MAX_THREADS; i++)
+        C->cell[i].v = 0;
+}
+
+// add n to the cell of thread tid, which must be the caller's own
+static inline void sharded_add(sharded_counter_t* C, int tid, unsigned long n)
+{
+    unsigned long s;
+    while ((s = C->shards) <= (unsigned long)tid)
+        cas(&C->shards, s, tid + 1);
+
+    unsigned long old = C->cell[tid].v;
+    C->cell[tid].v = old + n;
+    unsigned long batches = (old + n) / SHARDED_BATCH - old / SHARDED_BATCH;
+    if (batches)
+        faa(&C->approx, (int)(batches * SHARDED_BATCH));
+}
+
+static inline void sharded_inc(sharded_counter_t* C)
+{
+    sharded_add(C, (int)thread_index(), 1);
+}
+
+static inline unsigned long sharded_read_approx(sharded_counter_t* C)
+{
+    return C->approx;
+}
+
+static inline unsigned long sharded_read_exact(sharded_counter_t* C)
+{
+    unsigned long n = C->shards;
+    unsigned long sum = 0;
+    for (unsigned long i = 0; i < n; i++)
+        sum += C->cell[i].v;
+    return sum;
+}
+
+////////////////////////////////////////
+// combining-tree fetch-and-add
+//
+// Herlihy and Shavit's software combining tree.  Two threads share each
+// leaf; a thread climbs until it meets a node another thread reached
+// first, leaves its running total there for that thread to carry up, and
+// waits.  Only the root touches the count, and the prior value each
+// thread gets back is distributed down the same path, so every caller
+// still gets a unique fetch-and-add result.  Each node is a little
+// monitor: a tatas guard, plus a locked flag that holds later arrivals
+// off while a combined operation is in flight through it.
+
+#define CT_IDLE   0
+#define CT_FIRST  1
+#define CT_SECOND 2
+#define CT_RESULT 3
+#define CT_ROOT   4
+
+// a node only ever combines a first and a second arrival, so the tree is
+// binary; MAX_THREADS threads need MAX_THREADS / CTREE_FANIN leaves and
+// log2 of that plus one levels
+#define CTREE_FANIN 2
+#define CTREE_DEPTH 7             // enough for 1 << 6 == 128 / 2 leaves
+
+#if MAX_THREADS / CTREE_FANIN > 1 << (CTREE_DEPTH - 1)
+#error CTREE_DEPTH is too small for MAX_THREADS
+#endif
+
+extern "C"
+{
+    typedef struct _ctree_node_t
+    {
+        tatas_lock_t guard;
+        volatile unsigned long status;
+        volatile unsigned long locked;
+        volatile unsigned long first;
+        volatile unsigned long second;
+        volatile unsigned long result;
+        struct _ctree_node_t* parent;
+        char pad[CACHELINE_BYTES - 6 * sizeof(unsigned long) - sizeof(void*)];
+    } ctree_node_t;
+
+    // a heap: node[0] is the root, and leaves are the last `leaves' nodes
+    typedef struct
+    {
+        unsigned long leaves;
+        ctree_node_t node[MAX_THREADS];
+    } ctree_counter_t;
+}
+
+// give up the node's guard while waiting for its state to change
+static inline void ctree_wait(ctree_node_t* N)
+{
+    tatas_release(&N->guard);
+    spin64();
+    tatas_acquire(&N->guard);
+}
+
+static inline void ctree_init(ctree_counter_t* C, int n)
+{
+    C->leaves = 1;
+    while (CTREE_FANIN * C->leaves < (unsigned long)n)
+        C->leaves *= 2;
+    for (unsigned long i = 0; i < 2 * C->leaves - 1; i++) {
+        ctree_node_t* N = &C->node[i];
+        N->guard = 0;
+        N->status = (i == 0) ? CT_ROOT : CT_IDLE;
+        N->locked = 0;
+        N->first = N->second = N->result = 0;
+        N->parent = (i == 0) ? 0 : &C->node[(i - 1) / 2];
+    }
+}
+
+// true if the caller is first here and should keep climbing
+static inline bool ctree_precombine(ctree_node_t* N)
+{
+    bool up = false;
+    tatas_acquire(&N->guard);
+    while (N->locked)
+        ctree_wait(N);
+    if (N->status == CT_IDLE) {
+        N->status = CT_FIRST;
+        up = true;
+    }
+    else if (N->status == CT_FIRST) {
+        N->locked = 1;
+        N->status = CT_SECOND;
+    }
+    tatas_release(&N->guard);
+    return up;
+}
+
+static inline unsigned long ctree_combine(ctree_node_t* N, unsigned long v)
+{
+    tatas_acquire(&N->guard);
+    while (N->locked)
+        ctree_wait(N);
+    N->locked = 1;
+    N->first = v;
+    if (N->status == CT_SECOND)
+        v += N->second;
+    tatas_release(&N->guard);
+    return v;
+}
+
+static inline unsigned long ctree_op(ctree_node_t* N, unsigned long v)
+{
+    unsigned long prior;
+    tatas_acquire(&N->guard);
+    if (N->status == CT_ROOT) {
+        prior = N->result;
+        N->result = prior + v;
+    }
+    else {
+        // CT_SECOND: hand v to the first thread and wait for the answer
+        N->second = v;
+        N->locked = 0;
+        while (N->status != CT_RESULT)
+            ctree_wait(N);
+        N->locked = 0;
+        N->status = CT_IDLE;
+        prior = N->result;
+    }
+    tatas_release(&N->guard);
+    return prior;
+}
+
+static inline void ctree_distribute(ctree_node_t* N, unsigned long prior)
+{
+    tatas_acquire(&N->guard);
+    if (N->status == CT_FIRST) {
+        N->status = CT_IDLE;
+        N->locked = 0;
+    }
+    else {
+        N->result = prior + N->first;
+        N->status = CT_RESULT;
+    }
+    tatas_release(&N->guard);
+}
+
+// add v and return the value before the add; tid in [0, n)
+static inline unsigned long
+ctree_faa(ctree_counter_t* C, int tid, unsigned long v)
+{
+    ctree_node_t* leaf = &C->node[C->leaves - 1 + tid / CTREE_FANIN];
+    ctree_node_t* path[CTREE_DEPTH];        // one per level at most
+    int depth = 0;
+
+    ctree_node_t* stop = leaf;
+    while (ctree_precombine(stop))
+        stop = stop->parent;
+
+    for (ctree_node_t* N = leaf; N != stop; N = N->parent) {
+        if (depth >= CTREE_DEPTH)
+            abort();
+        v = ctree_combine(N, v);
+        path[depth++] = N;
+    }
+    unsigned long prior = ctree_op(stop, v);
+    while (depth > 0)
+        ctree_distribute(path[--depth], prior);
+    return prior;
+}
+
+static inline unsigned long ctree_read(ctree_counter_t* C)
+{
+    return C->node[0].result;
+}
+
+////////////////////////////////////////
+// epoch-based reclamation
+//
+// Fraser's scheme.  A thread announces the global epoch while it holds
+// references into a shared structure, and unlinked objects are retired
+// into a limbo list tagged with the epoch they were retired in.  The
+// epoch only advances once every active thread has seen it, so an object
+// retired in epoch e is unreachable by anyone once the epoch reaches
+// e + 2, and its whole list is freed in one batch.  Three lists per
+// thread are enough, indexed by epoch mod 3.
+
+#include <stdlib.h>
+
+// retires between attempts to advance the global epoch
+#define EBR_BATCH 64
+
+extern "C"
+{
+    typedef struct
+    {
+        void** item;
+        unsigned long n;
+        unsigned long cap;
+        unsigned long epoch;
+    } ebr_limbo_t;
+
+    typedef struct
+    {
+        volatile unsigned long state;     // epoch << 1 | 1 while active
+        unsigned long retired;
+        ebr_limbo_t limbo[3];
+        char pad[CACHELINE_BYTES - (2 + 3 * 4) * sizeof(unsigned long)
+                 % CACHELINE_BYTES];
+    } ebr_thread_t;
+
+    typedef struct
+    {
+        volatile unsigned long epoch;
+        void (*reclaim)(void*);
+        char pad[CACHELINE_BYTES - sizeof(unsigned long) - sizeof(void*)];
+        ebr_thread_t thr[MAX_THREADS];
+    } ebr_domain_t;
+}
+
+static inline void ebr_init(ebr_domain_t* D, void (*reclaim)(void*))
+{
+    D->epoch = 0;
+    D->reclaim = reclaim;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        D->thr[i].state = 0;
+        D->thr[i].retired = 0;
+        for (int j = 0; j < 3; j++) {
+            D->thr[i].limbo[j].item = 0;
+            D->thr[i].limbo[j].n = D->thr[i].limbo[j].cap = 0;
+            D->thr[i].limbo[j].epoch = 0;
+        }
+    }
+}
+
+static inline void ebr_free_limbo(ebr_domain_t* D, ebr_limbo_t* L)
+{
+    for (unsigned long i = 0; i < L->n; i++)
+        D->reclaim(L->item[i]);
+    L->n = 0;
+}
+
+// free every list retired two or more epochs before e
+static inline void ebr_collect(ebr_domain_t* D, ebr_thread_t* T,
+                               unsigned long e)
+{
+    for (int j = 0; j < 3; j++)
+        if (T->limbo[j].n && e - T->limbo[j].epoch >= 2)
+            ebr_free_limbo(D, &T->limbo[j]);
+}
+
+static inline void ebr_enter(ebr_domain_t* D)
+{
+    ebr_thread_t* T = &D->thr[thread_index()];
+    unsigned long e = D->epoch;
+    T->state = (e << 1) | 1;
+    // the announcement must be visible before any shared pointer is read
+    WBR;
+    ebr_collect(D, T, e);
+}
+
+static inline void ebr_exit(ebr_domain_t* D)
+{
+    LWSYNC;
+    D->thr[thread_index()].state = 0;
+}
+
+// advance the epoch if every active thread has announced the current one
+static inline bool ebr_try_advance(ebr_domain_t* D)
+{
+    unsigned long e = D->epoch;
+    unsigned long n = thread_count;
+    for (unsigned long i = 0; i < n; i++) {
+        unsigned long s = D->thr[i].state;
+        if ((s & 1) && (s >> 1) != e)
+            return false;
+    }
+    return bool_cas(&D->epoch, e, e + 1);
+}
+
+// hand p, already unlinked, to the domain to free once it is safe
+static inline void ebr_retire(ebr_domain_t* D, void* p)
+{
+    ebr_thread_t* T = &D->thr[thread_index()];
+    unsigned long e = D->epoch;
+    ebr_limbo_t* L = &T->limbo[e % 3];
+    // anything still here is from epoch e - 3 or before
+    if (L->epoch != e) {
+        ebr_free_limbo(D, L);
+        L->epoch = e;
+    }
+    if (L->n == L->cap) {
+        L->cap = L->cap ? 2 * L->cap : EBR_BATCH;
+        L->item = (void**)realloc(L->item, L->cap * sizeof(void*));
+    }
+    L->item[L->n++] = p;
+    if (++T->retired % EBR_BATCH == 0 && ebr_try_advance(D))
+        ebr_collect(D, T, e + 1);
+}
+
+// objects retired but not yet freed, over all threads
+static inline unsigned long ebr_pending(ebr_domain_t* D)
+{
+    unsigned long sum = 0;
+    for (int i = 0; i < MAX_THREADS; i++)
+        for (int j = 0; j < 3; j++)
+            sum += D->thr[i].limbo[j].n;
+    return sum;
+}
+
+////////////////////////////////////////
+// hazard pointers
+//
+// Michael's scheme.  Before dereferencing a shared pointer a thread
+// publishes it in one of its hazard slots and re-reads the source to
+// check it is still reachable.  Retired objects collect in a per-thread
+// list; once the list is long enough a scan snapshots every published
+// hazard and frees whatever is not among them.  Unlike epochs, a stalled
+// thread can only pin the HP_SLOTS objects it has published.
+
+#define HP_SLOTS 2
+
+// a scan runs once this many more objects are retired than there are
+// hazard slots in use, so each scan frees at least HP_BATCH of them
+#define HP_BATCH 64
+
+extern "C"
+{
+    typedef struct
+    {
+        void* volatile hp[HP_SLOTS];
+        void** retired;
+        unsigned long n;
+        unsigned long cap;
+        char pad[CACHELINE_BYTES - (HP_SLOTS + 3) * sizeof(void*)
+                 % CACHELINE_BYTES];
+    } hp_thread_t;
+
+    typedef struct
+    {
+        void (*reclaim)(void*);
+        char pad[CACHELINE_BYTES - sizeof(void*)];
+        hp_thread_t thr[MAX_THREADS];
+    } hp_domain_t;
+}
+
+static inline void hp_init(hp_domain_t* D, void (*reclaim)(void*))
+{
+    D->reclaim = reclaim;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        for (int j = 0; j < HP_SLOTS; j++)
+            D->thr[i].hp[j] = 0;
+        D->thr[i].retired = 0;
+        D->thr[i].n = D->thr[i].cap = 0;
+    }
+}
+
+// publish the pointer stored at src in the caller's slot and return it
+static inline void* hp_protect(hp_domain_t* D, int slot, void* volatile* src)
+{
+    void* volatile* hp = &D->thr[thread_index()].hp[slot];
+    void* p;
+    do {
+        p = *src;
+        *hp = p;
+        WBR;
+    } while (*src != p);
+    return p;
+}
+
+// publish p, which the caller then has to validate itself
+static inline void hp_set(hp_domain_t* D, int slot, void* p)
+{
+    D->thr[thread_index()].hp[slot] = p;
+    WBR;
+}
+
+static inline void hp_clear(hp_domain_t* D)
+{
+    LWSYNC;
+    for (int j = 0; j < HP_SLOTS; j++)
+        D->thr[thread_index()].hp[j] = 0;
+}
+
+static int hp_compare(const void* a, const void* b)
+{
+    unsigned long x = (unsigned long)*(void* const*)a;
+    unsigned long y = (unsigned long)*(void* const*)b;
+    return x < y ? -1 : x > y;
+}
+
+// free every retired object of the caller that no hazard slot holds
+static inline void hp_scan(hp_domain_t* D)
+{
+    hp_thread_t* T = &D->thr[thread_index()];
+    unsigned long threads = thread_count;
+    void* hazards[MAX_THREADS * HP_SLOTS];
+    unsigned long h = 0;
+    for (unsigned long i = 0; i < threads; i++)
+        for (int j = 0; j < HP_SLOTS; j++) {
+            void* p = D->thr[i].hp[j];
+            if (p)
+                hazards[h++] = p;
+        }
+    qsort(hazards, h, sizeof(void*), hp_compare);
+
+    unsigned long kept = 0;
+    for (unsigned long i = 0; i < T->n; i++) {
+        void* p = T->retired[i];
+        if (bsearch(&p, hazards, h, sizeof(void*), hp_compare))
+            T->retired[kept++] = p;
+        else
+            D->reclaim(p);
+    }
+    T->n = kept;
+}
+
+// hand p, already unlinked, to the domain to free once it is safe
+static inline void hp_retire(hp_domain_t* D, void* p)
+{
+    hp_thread_t* T = &D->thr[thread_index()];
+    if (T->n == T->cap) {
+        T->cap = T->cap ? 2 * T->cap : 2 * HP_BATCH;
+        T->retired = (void**)realloc(T->retired, T->cap * sizeof(void*));
+    }
+    T->retired[T->n++] = p;
+    if (T->n >= thread_count * HP_SLOTS + HP_BATCH)
+        hp_scan(D);
+}
+
+// objects retired but not yet freed, over all threads
+static inline unsigned long hp_pending(hp_domain_t* D)
+{
+    unsigned long sum = 0;
+    for (int i = 0; i < MAX_THREADS; i++)
+        sum += D->thr[i].n;
+    return sum;
+}
+
+////////////////////////////////////////
+// node pool
+//
+// Fixed-size blocks carved out of cache-aligned slabs that are never
+// given back to malloc, so the memory is type stable: a freed queue node
+// stays a node, and a thread still reading through a stale pointer reads
+// a node, not allocator metadata.  Each thread frees into and allocates
+// from a private list.  When that list grows past two batches, one batch
+// of POOL_BATCH blocks moves to a global lock-free list of batches.  An
+// empty private list takes a batch from there before cutting a new slab.
+//
+// The links live in the last two words of a block, not the first.  That
+// keeps a node's own leading next field, counted-pointer tag included,
+// untouched while the node sits in the pool.
+
+#define POOL_BATCH 64
+#define POOL_SLAB_BYTES 65536
+
+extern "C"
+{
+    typedef struct _pool_link_t
+    {
+        void* next;                       // next block in this batch
+        void* batch;                      // next batch on the global list
+    } pool_link_t;
+
+    typedef struct
+    {
+        void* head;
+        unsigned long n;
+        char pad[CACHELINE_BYTES - sizeof(void*) - sizeof(unsigned long)];
+    } pool_cache_t;
+
+    typedef struct
+    {
+        volatile unsigned long global;    // first block of the first batch
+        unsigned long size;
+        volatile unsigned long slabs;
+        char pad[CACHELINE_BYTES - 3 * sizeof(unsigned long)];
+        pool_cache_t cache[MAX_THREADS];
+    } pool_t;
+}
+
+static inline pool_link_t* pool_link(pool_t* P, void* b)
+{
+    return (pool_link_t*)((char*)b + P->size - sizeof(pool_link_t));
+}
+
+static inline void pool_init(pool_t* P, unsigned long size)
+{
+    // room for the links, and blocks that keep 2-word alignment
+    if (size < sizeof(pool_link_t))
+        size = sizeof(pool_link_t);
+    P->size = (size + sizeof(pool_link_t) - 1) & ~(sizeof(pool_link_t) - 1);
+    P->global = 0;
+    P->slabs = 0;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        P->cache[i].head = 0;
+        P->cache[i].n = 0;
+    }
+}
+
+// push a chain of batches whose last batch starts at last
+static inline void pool_push(pool_t* P, void* first, void* last)
+{
+    unsigned long old;
+    do {
+        old = P->global;
+        pool_link(P, last)->batch = (void*)old;
+    } while (!bool_cas(&P->global, old, (unsigned long)first));
+}
+
+// fill an empty cache from the global list, or else from a new slab
+static inline void pool_refill(pool_t* P, pool_cache_t* C)
+{
+    // taking the whole list with a swap sidesteps the ABA problem of
+    // popping one batch; all but the first batch go straight back
+    void* b = (void*)swap(&P->global, 0);
+    if (b) {
+        void* rest = pool_link(P, b)->batch;
+        if (rest) {
+            void* last = rest;
+            while (pool_link(P, last)->batch)
+                last = pool_link(P, last)->batch;
+            pool_push(P, rest, last);
+        }
+        C->head = b;
+        C->n = POOL_BATCH;
+        return;
+    }
+
+    char* slab;
+#if defined(_MSC_VER)
+    slab = (char*)_aligned_malloc(POOL_SLAB_BYTES, CACHELINE_BYTES);
+#else
+    if (posix_memalign((void**)&slab, CACHELINE_BYTES, POOL_SLAB_BYTES))
+        slab = 0;
+#endif
+    if (!slab)
+        abort();
+    fai(&P->slabs);
+    unsigned long count = POOL_SLAB_BYTES / P->size;
+    for (unsigned long i = 0; i < count; i++)
+        pool_link(P, slab + i * P->size)->next =
+            (i + 1 < count) ? slab + (i + 1) * P->size : 0;
+    C->head = slab;
+    C->n = count;
+}
+
+static inline void* pool_alloc(pool_t* P)
+{
+    pool_cache_t* C = &P->cache[thread_index()];
+    if (!C->head)
+        pool_refill(P, C);
+    void* b = C->head;
+    C->head = pool_link(P, b)->next;
+    C->n--;
+    return b;
+}
+
+static inline void pool_free(pool_t* P, void* b)
+{
+    pool_cache_t* C = &P->cache[thread_index()];
+    pool_link(P, b)->next = C->head;
+    C->head = b;
+    if (++C->n < 2 * POOL_BATCH)
+        return;
+
+    // cut the first POOL_BATCH blocks off and publish them as one batch
+    void* last = b;
+    for (int i = 1; i < POOL_BATCH; i++)
+        last = pool_link(P, last)->next;
+    C->head = pool_link(P, last)->next;
+    C->n -= POOL_BATCH;
+    pool_link(P, last)->next = 0;
+    pool_push(P, b, b);
+}
+
+////////////////////////////////////////
+// bounded MPMC ring
+//
+// Vyukov's bounded multi-producer multi-consumer queue.  Each cell carries
+// a sequence number saying whose turn it is: the cell for position pos is
+// free for the enqueuer that claims pos when seq == pos, and holds an item
+// for the dequeuer that claims pos when seq == pos + 1.  Claiming a
+// position is one CAS on the enqueue or dequeue index; the item itself is
+// a plain store, published by the seq store after it.  The capacity is
+// fixed at init and rounded up to a power of two.  Enqueue fails when the
+// ring is full and dequeue when it is empty, and nothing is allocated
+// after init.
+
+// the capacity doubles up to at most this power of two, so it cannot wrap
+// to 0; a ring that size does not fit in memory anyway and init aborts
+#define RING_TOP_BIT (1UL << (8 * sizeof(unsigned long) - 1))
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile unsigned long seq;
+        volatile unsigned long data;
+    } mpmc_cell_t;
+
+    typedef struct
+    {
+        mpmc_cell_t* cell;
+        unsigned long mask;
+        char pad0[CACHELINE_BYTES - 2 * sizeof(unsigned long)];
+        volatile unsigned long enq_pos;   // next position to enqueue at
+        char pad1[CACHELINE_BYTES - sizeof(unsigned long)];
+        volatile unsigned long deq_pos;   // next position to dequeue from
+        char pad2[CACHELINE_BYTES - sizeof(unsigned long)];
+    } mpmc_ring_t;
+}
+
+static inline void mpmc_init(mpmc_ring_t* R, unsigned long capacity)
+{
+    unsigned long n = 2;
+    while (n < capacity && !(n & RING_TOP_BIT))
+        n <<= 1;
+    if (n > ~0UL / sizeof(mpmc_cell_t))
+        abort();
+#if defined(_MSC_VER)
+    R->cell = (mpmc_cell_t*)_aligned_malloc(n * sizeof(mpmc_cell_t), CACHELINE_BYTES);
+#else
+    if (posix_memalign((void**)&R->cell, CACHELINE_BYTES, n * sizeof(mpmc_cell_t)))
+        R->cell = 0;
+#endif
+    if (!R->cell)
+        abort();
+    for (unsigned long i = 0; i < n; i++) {
+        R->cell[i].seq = i;
+        R->cell[i].data = 0;
+    }
+    R->mask = n - 1;
+    R->enq_pos = 0;
+    R->deq_pos = 0;
+}
+
+static inline unsigned long mpmc_capacity(mpmc_ring_t* R)
+{
+    return R->mask + 1;
+}
+
+static inline bool mpmc_enqueue(mpmc_ring_t* R, unsigned long v)
+{
+    mpmc_cell_t* c;
+    unsigned long pos = R->enq_pos;
+    for (;;) {
+        c = &R->cell[pos & R->mask];
+        long dif = (long)(c->seq - pos);
+        if (dif == 0 && bool_cas(&R->enq_pos, pos, pos + 1))
+            break;
+        // a dequeuer has not emptied this cell since the last lap
+        if (dif < 0)
+            return false;
+        pos = R->enq_pos;
+    }
+    c->data = v;
+    LWSYNC;
+    c->seq = pos + 1;
+    return true;
+}
+
+static inline bool mpmc_dequeue(mpmc_ring_t* R, unsigned long* v)
+{
+    mpmc_cell_t* c;
+    unsigned long pos = R->deq_pos;
+    for (;;) {
+        c = &R->cell[pos & R->mask];
+        long dif = (long)(c->seq - (pos + 1));
+        if (dif == 0 && bool_cas(&R->deq_pos, pos, pos + 1))
+            break;
+        // no enqueuer has filled this cell yet
+        if (dif < 0)
+            return false;
+        pos = R->deq_pos;
+    }
+    ISYNC;
+    *v = c->data;
+    LWSYNC;
+    // free for the enqueuer one lap on
+    c->seq = pos + R->mask + 1;
+    return true;
+}
+
+////////////////////////////////////////
+// SPSC ring
+//
+// A ring for exactly one producer and one consumer, in the style of
+// FastForward and B-Queue.  Each side keeps its working index and a cached
+// copy of the other side's index on a cache line of its own.  It only
+// rereads the other side's line when the cached copy says the ring is full
+// (producer) or empty (consumer).  Neither side publishes its index on
+// every operation, only every batch items, so the two lines change hands
+// once per batch rather than once per item.  A side that finds the ring
+// full or empty publishes what it has first, so the two sides cannot wait
+// on each other.  A producer that is done calls spsc_flush.
+
+#define SPSC_BATCH 32
+
+extern "C"
+{
+    typedef struct
+    {
+        volatile unsigned long tail;      // published by the producer
+        unsigned long ptail;              // producer's next slot
+        unsigned long head_cache;         // producer's copy of head
+        char pad0[CACHELINE_BYTES - 3 * sizeof(unsigned long)];
+        volatile unsigned long head;      // published by the consumer
+        unsigned long chead;              // consumer's next slot
+        unsigned long tail_cache;         // consumer's copy of tail
+        char pad1[CACHELINE_BYTES - 3 * sizeof(unsigned long)];
+        volatile unsigned long* slot;
+        unsigned long mask;
+        unsigned long batch;
+        char pad2[CACHELINE_BYTES - 3 * sizeof(unsigned long)];
+    } spsc_ring_t;
+}
+
+// capacity is rounded up to a power of two, as for the MPMC ring; batch is
+// capped at half of it
+static inline void spsc_init(spsc_ring_t* R, unsigned long capacity, unsigned long batch)
+{
+    unsigned long n = 2;
+    while (n < capacity && !(n & RING_TOP_BIT))
+        n <<= 1;
+    if (n > ~0UL / sizeof(unsigned long))
+        abort();
+#if defined(_MSC_VER)
+    R->slot = (volatile unsigned long*)_aligned_malloc(n * sizeof(unsigned long), CACHELINE_BYTES);
+#else
+    if (posix_memalign((void**)&R->slot, CACHELINE_BYTES, n * sizeof(unsigned long)))
+        R->slot = 0;
+#endif
+    if (!R->slot)
+        abort();
+    R->mask = n - 1;
+    R->batch = (batch < 1) ? 1 : (batch > n / 2) ? n / 2 : batch;
+    R->tail = R->ptail = R->head_cache = 0;
+    R->head = R->chead = R->tail_cache = 0;
+}
+
+// make every item enqueued so far visible to the consumer
+static inline void spsc_flush(spsc_ring_t* R)
+{
+    LWSYNC;
+    R->tail = R->ptail;
+}
+
+static inline bool spsc_enqueue(spsc_ring_t* R, unsigned long v)
+{
+    unsigned long t = R->ptail;
+    if (t - R->head_cache > R->mask) {
+        R->head_cache = R->head;
+        if (t - R->head_cache > R->mask) {
+            spsc_flush(R);
+            return false;
+        }
+        ISYNC;
+    }
+    R->slot[t & R->mask] = v;
+    R->ptail = t + 1;
+    if (R->ptail - R->tail >= R->batch)
+        spsc_flush(R);
+    return true;
+}
+
+static inline bool spsc_dequeue(spsc_ring_t* R, unsigned long* v)
+{
+    unsigned long h = R->chead;
+    if (h == R->tail_cache) {
+        R->tail_cache = R->tail;
+        if (h == R->tail_cache) {
+            // hand back the slots already read before reporting empty
+            if (R->head != h) {
+                LWSYNC;
+                R->head = h;
+            }
+            return false;
+        }
+        ISYNC;
+    }
+    *v = R->slot[h & R->mask];
+    R->chead = h + 1;
+    if (R->chead - R->head >= R->batch) {
+        LWSYNC;
+        R->head = R->chead;
+    }
+    return true;
+}
+
+////////////////////////////////////////
+// FAA segment queue
+//
+// An unbounded queue in the style of LCRQ, as simplified in Ramalhete
+// and Correia's FAAArrayQueue.  The queue is a linked list of fixed-size
+// segments.  An enqueuer takes a slot in the tail segment with one
+// fetch-and-add on its enqueue index and CASes the item into it; a
+// dequeuer takes a slot with one fetch-and-add on the dequeue index and
+// swaps FAAQ_TAKEN into it.  If the dequeuer gets there first, the swap
+// leaves the slot taken, the enqueuer's CAS fails, and the enqueuer takes
+// another slot.  So an operation normally costs one FAA on a shared
+// index, which cannot fail, and one CAS or swap on a slot nobody else
+// wants, instead of CAS retries on a shared tail.  An index past the end
+// of a segment means that segment is used up: enqueuers append a new one,
+// and dequeuers move the head on to it and retire the old one through the
+// queue's own epoch domain.  Segments are used once rather than recycled
+// as rings, which keeps every CAS single-word.  Items may not be 0 or
+// FAAQ_TAKEN.
+
+#define FAAQ_SEGMENT 1024
+#define FAAQ_TAKEN (~0UL)
+
+// one locked add, unlike faa(), which is a CAS loop and so retries under
+// contention just as the MS queue's tail does
+static inline unsigned long xadd(volatile unsigned long* ptr, long amnt)
+{
+#if defined(_MSC_VER)
+    return (unsigned long)_InterlockedExchangeAdd((volatile long*)ptr, amnt);
+#else
+    return __sync_fetch_and_add(ptr, amnt);
+#endif
+}
+
+extern "C"
+{
+    typedef struct _faaq_segment_t
+    {
+        volatile unsigned long deq;       // next slot to dequeue from
+        char pad0[CACHELINE_BYTES - sizeof(unsigned long)];
+        volatile unsigned long enq;       // next slot to enqueue at
+        char pad1[CACHELINE_BYTES - sizeof(unsigned long)];
+        struct _faaq_segment_t* volatile next;
+        char pad2[CACHELINE_BYTES - sizeof(void*)];
+        volatile unsigned long slot[FAAQ_SEGMENT];
+    } faaq_segment_t;
+
+    typedef struct
+    {
+        faaq_segment_t* volatile head;
+        char pad0[CACHELINE_BYTES - sizeof(void*)];
+        faaq_segment_t* volatile tail;
+        char pad1[CACHELINE_BYTES - sizeof(void*)];
+        volatile unsigned long segments;  // linked in so far
+        char pad2[CACHELINE_BYTES - sizeof(unsigned long)];
+        ebr_domain_t ebr;
+    } faa_queue_t;
+}
+
+static inline void faaq_free_segment(void* p)
+{
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// a segment whose first slot already holds v, or an empty one if v is 0
+static inline faaq_segment_t* faaq_new_segment(unsigned long v)
+{
+    faaq_segment_t* S;
+#if defined(_MSC_VER)
+    S = (faaq_segment_t*)_aligned_malloc(sizeof(faaq_segment_t), CACHELINE_BYTES);
+#else
+    if (posix_memalign((void**)&S, CACHELINE_BYTES, sizeof(faaq_segment_t)))
+        S = 0;
+#endif
+    if (!S)
+        abort();
+    S->deq = 0;
+    S->enq = v ? 1 : 0;
+    S->next = 0;
+    S->slot[0] = v;
+    for (int i = 1; i < FAAQ_SEGMENT; i++)
+        S->slot[i] = 0;
+    return S;
+}
+
+static inline void faaq_init(faa_queue_t* Q)
+{
+    Q->segments = 1;
+    Q->head = Q->tail = faaq_new_segment(0);
+    ebr_init(&Q->ebr, faaq_free_segment);
+}
+
+static inline void faaq_enqueue(faa_queue_t* Q, unsigned long v)
+{
+    ebr_enter(&Q->ebr);
+    for (;;) {
+        faaq_segment_t* t = Q->tail;
+        unsigned long i = xadd(&t->enq, 1);
+        if (i < FAAQ_SEGMENT) {
+            if (bool_cas(&t->slot[i], 0, v))
+                break;
+            continue;
+        }
+        // t is used up: link a new segment holding v, or help the one
+        // that is already there become the tail
+        if (t != Q->tail)
+            continue;
+        faaq_segment_t* n = t->next;
+        if (n) {
+            bool_cas((volatile unsigned long*)&Q->tail, (unsigned long)t, (unsigned long)n);
+            continue;
+        }
+        n = faaq_new_segment(v);
+        if (bool_cas((volatile unsigned long*)&t->next, 0, (unsigned long)n)) {
+            bool_cas((volatile unsigned long*)&Q->tail, (unsigned long)t, (unsigned long)n);
+            fai(&Q->segments);
+            break;
+        }
+        // another enqueuer linked its segment first; ours was never seen
+        faaq_free_segment(n);
+    }
+    ebr_exit(&Q->ebr);
+}
+
+static inline bool faaq_dequeue(faa_queue_t* Q, unsigned long* v)
+{
+    for (;;) {
+        faaq_segment_t* h;
+        ebr_enter(&Q->ebr);
+        for (;;) {
+            h = Q->head;
+            if (h->deq >= h->enq && h->next == 0) {
+                ebr_exit(&Q->ebr);
+                return false;
+            }
+            unsigned long i = xadd(&h->deq, 1);
+            if (i >= FAAQ_SEGMENT)
+                break;
+            unsigned long x = swap(&h->slot[i], FAAQ_TAKEN);
+            if (x != 0) {
+                ebr_exit(&Q->ebr);
+                *v = x;
+                return true;
+            }
+        }
+        // h is used up: move the head on, then look in the next segment
+        faaq_segment_t* n = h->next;
+        if (n == 0) {
+            ebr_exit(&Q->ebr);
+            return false;
+        }
+        // the tail may lag behind; it must not be left on a freed segment
+        if (Q->tail == h)
+            bool_cas((volatile unsigned long*)&Q->tail, (unsigned long)h, (unsigned long)n);
+        bool unlinked = bool_cas((volatile unsigned long*)&Q->head, (unsigned long)h, (unsigned long)n);
+        ebr_exit(&Q->ebr);
+        if (unlinked)
+            ebr_retire(&Q->ebr, h);
+    }
+}
+
 #endif // ATOMIC_OPS_H__
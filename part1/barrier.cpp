@@ -0,0 +1,148 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+int iterations;
+int NUM_THREADS;
+
+//the barrier kinds, in the order they are reported
+enum { B_CENTRAL, B_COMBINING, B_TOURNAMENT, B_DISSEMINATION, B_PTHREAD, B_KINDS };
+const char *names[B_KINDS] = { "central", "combining", "tournament", "dissemination", "pthread" };
+
+//barrier and thread count of the current run
+int kind;
+int nthreads;
+
+central_barrier_t central;
+combining_barrier_t combining;
+tournament_barrier_t tournament;
+dissemination_barrier_t dissemination;
+pthread_barrier_t pbarrier;
+
+//each thread publishes the episode it reached; a neighbour still behind it
+//after the barrier means the barrier let someone through early
+padded_flag_t episode[MAX_THREADS];
+volatile int broken = 0;
+
+void barrier(int tid)
+{
+	switch(kind) {
+	case B_CENTRAL:       central_barrier_wait(&central, tid); break;
+	case B_COMBINING:     combining_barrier_wait(&combining, tid); break;
+	case B_TOURNAMENT:    tournament_barrier_wait(&tournament, tid); break;
+	case B_DISSEMINATION: dissemination_barrier_wait(&dissemination, tid); break;
+	default:              pthread_barrier_wait(&pbarrier); break;
+	}
+}
+
+void *run_thread(void *threadid)
+{
+	long tid;
+	tid = (long)threadid;
+	int i;
+	for(i = 1; i <= iterations; i++) {
+		episode[tid].v = i;
+		barrier(tid);
+		if(episode[(tid + 1) % nthreads].v < (unsigned long)i)
+			broken = 1;
+		//nobody may start the next episode until everyone has checked
+		barrier(tid);
+	}
+	pthread_exit(NULL);
+}
+
+//time n threads going through 2 * iterations episodes of one barrier
+double run_setting(int k, int n)
+{
+	pthread_t threads[n];
+	int rc;
+	int i;
+	void *status;
+
+	kind = k;
+	nthreads = n;
+	central_barrier_init(&central, n);
+	combining_barrier_init(&combining, n);
+	tournament_barrier_init(&tournament, n);
+	dissemination_barrier_init(&dissemination, n);
+	pthread_barrier_init(&pbarrier, NULL, n);
+	for( i=0; i < n; i++ )
+		episode[i].v = 0;
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < n; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < n; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+	pthread_barrier_destroy(&pbarrier);
+	return end - start;
+}
+
+int main(int argc, char* argv[])
+{
+	//default values for number of threads & episodes
+	NUM_THREADS = 4;
+	iterations  = 10000;
+	int only = -1;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t max_threads -i episodes [-m central|combining|tournament|dissemination|pthread] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(argc >6)
+		for(int k = 0; k < B_KINDS; k++)
+			if(strcmp(argv[6], names[k]) == 0)
+				only = k;
+	if(NUM_THREADS > MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS << " threads" << std::endl;
+	return 1;
+	}
+
+	//every barrier at 2, 4, 8, ... threads, and at NUM_THREADS itself
+	for(int n = 2; ; n *= 2) {
+		if(n > NUM_THREADS)
+			n = NUM_THREADS;
+		for(int k = 0; k < B_KINDS; k++) {
+			if(only >= 0 && k != only)
+				continue;
+			double t = run_setting(k, n);
+			cout << names[k] << " barrier, " << n << " threads : Execution time ="
+			     << t << " nsec, " << 2.0 * iterations * 1e9 / t << " episodes/sec\n";
+		}
+		if(n == NUM_THREADS)
+			break;
+	}
+	if(broken)
+		cout << "a barrier released a thread early\n";
+	pthread_exit(NULL);
+}
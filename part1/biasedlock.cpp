@@ -0,0 +1,144 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+
+//number of acquires made by each thread other than the owner (thread 0)
+int foreign_iterations = 0;
+bool use_tatas = false;
+
+biased_lock_t biased;
+tatas_lock_t flag = 0;
+
+//the owner takes the lock first so that the bias goes to it
+volatile unsigned long owner_started = 0;
+
+//time each thread spent in acquires that revoked the bias; every foreign
+//acquire does, and the owner gets the bias back when it is released
+double revocation_time[MAX_THREADS];
+
+void acquire()
+{
+	if(use_tatas)
+		tatas_acquire(&flag);
+	else
+		biased_acquire(&biased);
+}
+
+void release()
+{
+	if(use_tatas)
+		tatas_release(&flag);
+	else
+		biased_release(&biased);
+}
+
+void *run_thread(void *threadid)
+{
+	long tid;
+	tid = (long)threadid;
+	int i;
+	int n = (tid == 0) ? iterations : foreign_iterations;
+	bool revoking = !use_tatas && tid != 0;
+	double spent = 0;
+
+	if(tid != 0)
+		while(!owner_started) { } // spin
+
+	for(i = 1; i <= n; i++) {
+		double start = revoking ? getElapsedTime() : 0;
+		acquire();
+		if(revoking)
+			spent += getElapsedTime() - start;
+		counter++;
+		release();
+		if(tid == 0)
+			owner_started = 1;
+	}
+	revocation_time[tid] = spent;
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	biased_init(&biased);
+
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-f foreign_acquires] [-m biased|tatas] [-b membarrier|fence] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	//skewed-owner mode: the other threads only take the lock now and then
+	if(argc >6)
+		foreign_iterations = atoi(argv[6]);
+	if(argc >8)
+		use_tatas = (strcmp(argv[8], "tatas") == 0);
+	if(NUM_THREADS > MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS << " threads" << std::endl;
+	return 1;
+	}
+	//membarrier revocation is used when the kernel supports it
+	if(argc <=10 || strcmp(argv[10], "fence") != 0)
+		biased_enable_membarrier();
+
+	pthread_t threads[NUM_THREADS];
+	int rc;
+	int i;
+	void *status;
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+
+	cout << (use_tatas ? "tatas" : "biased") << " : Counter = " << counter << endl;
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	if(!use_tatas) {
+		double total = 0;
+		for( i=0; i < NUM_THREADS; i++ )
+			total += revocation_time[i];
+		cout << "Revocation by " << (bias_use_membarrier ? "membarrier" : "fence");
+		if(biased.revocations)
+			cout << " : " << biased.revocations << " revocations, average "
+			     << total / biased.revocations << " nsec\n";
+		else
+			cout << " never needed\n";
+	}
+	pthread_exit(NULL);
+}
@@ -0,0 +1,334 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+int NUM_THREADS;
+
+//every way of counting, in the order they are run
+enum { C_PTHREAD, C_TAS, C_TATAS, C_ADAPTIVE, C_TICKET, C_MCS, C_MCSCR, C_K42,
+       C_HEMLOCK, C_QSPIN, C_REACTIVE, C_BIASED, C_BYTE, C_PRIO, C_FC, C_DELEG,
+       C_FAA, C_CTREE, C_SHARDED, C_KINDS };
+const char *names[C_KINDS] = { "pthread", "tas", "tatas", "adaptive", "ticket", "mcs",
+       "mcscr", "k42", "hemlock", "qspin", "reactive", "biased", "byte", "prio", "fc",
+       "delegation", "faa", "ctree", "sharded" };
+
+pthread_mutex_t myMutex;
+tatas_lock_t flag = 0;
+adaptive_lock_t adaptive;
+ticket_lock_t ticket;
+mcs_qnode_t *mcslock = NULL;
+mcscr_lock_t mcscr;
+k42_lock_t k42;
+hemlock_t hem = 0;
+qspin_lock_t qspin = 0;
+reactive_lock_t reactive;
+biased_lock_t biased;
+byte_lock_t bytelock = 0;
+prio_lock_t prio;
+fc_lock_t fc;
+dl_server_t server;
+sharded_counter_t sharded;
+ctree_counter_t ctree;
+
+//every ctree_faa must return a different prior value, so between them the
+//threads mark each of 0..NUM_THREADS*iterations-1 exactly once
+unsigned char *ctree_seen = NULL;
+volatile int ctree_broken = 0;
+
+//the threads stay up for the whole sweep and meet at a barrier between
+//settings, so thread_index() based locks see the same threads throughout
+central_barrier_t bar;
+int first_kind = 0, last_kind = C_KINDS;
+double elapsed[C_KINDS];
+unsigned long result[C_KINDS];
+
+//critical section for the flat combiner and the delegation server
+void fc_increment(void *)
+{
+	counter++;
+}
+
+unsigned long dl_increment(void *)
+{
+	return ++counter;
+}
+
+void *server_thread(void *)
+{
+	dl_serve(&server);
+	pthread_exit(NULL);
+}
+
+void run_kind(int kind, long tid)
+{
+	int i;
+	switch(kind) {
+	case C_PTHREAD:
+		for(i = 1; i <= iterations; i++) {
+			pthread_mutex_lock(&myMutex);
+			counter++;
+			pthread_mutex_unlock(&myMutex);
+		}
+		break;
+	case C_TAS:
+		for(i = 1; i <= iterations; i++) {
+			while (tas(&flag)) { } // spin
+			counter++;
+			tatas_release(&flag);
+		}
+		break;
+	case C_TATAS:
+		for(i = 1; i <= iterations; i++) {
+			tatas_acquire(&flag);
+			counter++;
+			tatas_release(&flag);
+		}
+		break;
+	case C_ADAPTIVE:
+		for(i = 1; i <= iterations; i++) {
+			adaptive_acquire(&adaptive);
+			counter++;
+			adaptive_release(&adaptive);
+		}
+		break;
+	case C_TICKET:
+		for(i = 1; i <= iterations; i++) {
+			ticket_acquire(&ticket);
+			counter++;
+			ticket_release(&ticket);
+		}
+		break;
+	case C_MCS:
+		for(i = 1; i <= iterations; i++) {
+			mcs_qnode_t newNode;
+			mcs_acquire(&mcslock, &newNode);
+			counter++;
+			mcs_release(&mcslock, &newNode);
+		}
+		break;
+	case C_MCSCR:
+		for(i = 1; i <= iterations; i++) {
+			mcs_qnode_t newNode;
+			mcscr_acquire(&mcscr, &newNode);
+			counter++;
+			mcscr_release(&mcscr, &newNode);
+		}
+		break;
+	case C_K42:
+		for(i = 1; i <= iterations; i++) {
+			k42_acquire(&k42);
+			counter++;
+			k42_release(&k42);
+		}
+		break;
+	case C_HEMLOCK:
+		for(i = 1; i <= iterations; i++) {
+			hemlock_acquire(&hem);
+			counter++;
+			hemlock_release(&hem);
+		}
+		break;
+	case C_QSPIN:
+		for(i = 1; i <= iterations; i++) {
+			qspin_acquire(&qspin);
+			counter++;
+			qspin_release(&qspin);
+		}
+		break;
+	case C_REACTIVE:
+		for(i = 1; i <= iterations; i++) {
+			reactive_acquire(&reactive);
+			counter++;
+			reactive_release(&reactive);
+		}
+		break;
+	case C_BIASED:
+		for(i = 1; i <= iterations; i++) {
+			biased_acquire(&biased);
+			counter++;
+			biased_release(&biased);
+		}
+		break;
+	case C_BYTE:
+		for(i = 1; i <= iterations; i++) {
+			byte_lock_acquire(&bytelock);
+			counter++;
+			byte_lock_release(&bytelock);
+		}
+		break;
+	case C_PRIO:
+		//the threads alternate between the two classes
+		for(i = 1; i <= iterations; i++) {
+			prio_qnode_t newNode;
+			prio_acquire(&prio, &newNode, (int)(tid % PRIO_CLASSES));
+			counter++;
+			prio_release(&prio);
+		}
+		break;
+	case C_FC:
+		for(i = 1; i <= iterations; i++)
+			fc_execute(&fc, fc_increment, NULL);
+		break;
+	case C_DELEG:
+		for(i = 1; i <= iterations; i++)
+			dl_execute(&server, dl_increment, NULL);
+		break;
+	case C_FAA:
+		//one locked add per increment on the shared line
+		for(i = 1; i <= iterations; i++)
+			__sync_fetch_and_add(&counter, 1);
+		break;
+	case C_CTREE:
+		//still one unique value per increment, but combined up a tree
+		for(i = 1; i <= iterations; i++) {
+			unsigned long v = ctree_faa(&ctree, (int)tid, 1);
+			if(v >= (unsigned long)NUM_THREADS * iterations || ctree_seen[v])
+				ctree_broken = 1;
+			else
+				ctree_seen[v] = 1;
+		}
+		break;
+	case C_SHARDED:
+		for(i = 1; i <= iterations; i++)
+			sharded_add(&sharded, (int)tid, 1);
+		break;
+	}
+}
+
+void *run_thread(void *threadid)
+{
+	long tid;
+	tid = (long)threadid;
+	double start = 0;
+	//the delegation server only runs for its own setting, so that it does
+	//not take processor time from the others
+	pthread_t server_tid;
+	void *status;
+	for(int k = first_kind; k < last_kind; k++) {
+		central_barrier_wait(&bar, tid);
+		if(tid == 0) {
+			counter = 0;
+			if(k == C_DELEG && pthread_create(&server_tid, NULL, server_thread, NULL)) {
+				cout << "Error:unable to create server thread" << endl;
+				exit(-1);
+			}
+			start = getElapsedTime();
+		}
+		central_barrier_wait(&bar, tid);
+		run_kind(k, tid);
+		central_barrier_wait(&bar, tid);
+		if(tid == 0) {
+			elapsed[k] = getElapsedTime() - start;
+			if(k == C_SHARDED)
+				result[k] = sharded_read_exact(&sharded);
+			else if(k == C_CTREE)
+				result[k] = ctree_read(&ctree);
+			else
+				result[k] = counter;
+			if(k == C_DELEG) {
+				dl_stop(&server);
+				pthread_join(server_tid, &status);
+			}
+		}
+	}
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	pthread_mutex_init(&myMutex, 0);
+	adaptive_init(&adaptive);
+	ticket.next_ticket = 0;
+	ticket.now_serving = 0;
+	mcscr_init(&mcscr);
+	k42_init(&k42);
+	reactive_init(&reactive);
+	biased_init(&biased);
+	prio_init(&prio);
+	fc_init(&fc);
+	dl_init(&server);
+	sharded_init(&sharded);
+
+	//default values for number of threads & iterations
+	NUM_THREADS = 4;
+	iterations  = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m pthread|tas|...|faa|ctree|sharded] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	//a single setting instead of the whole sweep
+	if(argc >6)
+		for(int k = 0; k < C_KINDS; k++)
+			if(strcmp(argv[6], names[k]) == 0) {
+				first_kind = k;
+				last_kind = k + 1;
+			}
+	if(NUM_THREADS > MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS << " threads" << std::endl;
+	return 1;
+	}
+	central_barrier_init(&bar, NUM_THREADS);
+	ctree_init(&ctree, NUM_THREADS);
+	if(first_kind <= C_CTREE && last_kind > C_CTREE)
+		ctree_seen = (unsigned char *)calloc((size_t)NUM_THREADS * iterations, 1);
+
+	pthread_t threads[NUM_THREADS];
+	int rc;
+	int i;
+	void *status;
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+
+	for(int k = first_kind; k < last_kind; k++) {
+		cout << names[k] << " : Counter = " << result[k]
+		     << ", Execution time =" << elapsed[k] << " nsec"
+		     << ", Throughput =" << (double)NUM_THREADS * iterations * 1e9 / elapsed[k] << " ops/sec\n";
+	}
+	if(ctree_seen) {
+		for(unsigned long v = 0; v < (unsigned long)NUM_THREADS * iterations; v++)
+			if(!ctree_seen[v])
+				ctree_broken = 1;
+		if(ctree_broken)
+			cout << "ctree returned a duplicate or out of range value\n";
+		else
+			cout << "ctree returned every value from 0 to " << (unsigned long)NUM_THREADS * iterations - 1 << " once\n";
+		free(ctree_seen);
+	}
+	if(last_kind > C_SHARDED && first_kind <= C_SHARDED)
+		cout << "sharded approximate read = " << sharded_read_approx(&sharded)
+		     << " (" << sizeof(sharded) << " bytes)\n";
+	pthread_mutex_destroy(&myMutex);
+	pthread_exit(NULL);
+}
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+
+//which lock protects the counter: delegation (default), ticket or mcs
+enum { MODE_DL, MODE_TICKET, MODE_MCS } mode = MODE_DL;
+
+dl_server_t server;
+ticket_lock_t ticket;
+mcs_qnode_t *mcslock = NULL;
+
+//opcode shipped to the server thread
+unsigned long increment(void *)
+{
+	return ++counter;
+}
+
+void *server_thread(void *)
+{
+	dl_serve(&server);
+	pthread_exit(NULL);
+}
+
+void *run_thread(void *)
+{
+	int i;
+	for(i = 1; i <= iterations; i++) {
+		if(mode == MODE_DL)
+			dl_execute(&server, increment, NULL);
+		else if(mode == MODE_TICKET) {
+			ticket_acquire(&ticket);
+			counter++;
+			ticket_release(&ticket);
+		}
+		else {
+			mcs_qnode_t newNode;
+			mcs_acquire(&mcslock, &newNode);
+			counter++;
+			mcs_release(&mcslock, &newNode);
+		}
+	}
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	dl_init(&server);
+	ticket.next_ticket = 0;
+	ticket.now_serving = 0;
+
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m dl|ticket|mcs] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(argc >6)
+	{
+		if(strcmp(argv[6], "ticket") == 0)
+			mode = MODE_TICKET;
+		else if(strcmp(argv[6], "mcs") == 0)
+			mode = MODE_MCS;
+	}
+	if(NUM_THREADS > MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS << " threads" << std::endl;
+	return 1;
+	}
+
+	pthread_t threads[NUM_THREADS];
+	pthread_t server_tid;
+	int rc;
+	int i;
+	void *status;
+
+	//the server owns the counter for the whole run
+	if(mode == MODE_DL) {
+		rc = pthread_create(&server_tid, NULL, server_thread, NULL);
+		if (rc){
+		  cout << "Error:unable to create server thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+
+	if(mode == MODE_DL) {
+		dl_stop(&server);
+		pthread_join(server_tid, &status);
+	}
+
+	cout << "Counter = " << counter << endl;
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)NUM_THREADS * iterations * 1e9 / (end - start) << " ops/sec\n";
+	pthread_exit(NULL);
+}
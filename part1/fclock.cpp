@@ -0,0 +1,120 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+bool use_mcs = false;
+int NUM_THREADS;
+
+fc_lock_t lock;
+mcs_qnode_t *mcslock = NULL;
+
+//critical section handed to the combiner
+void increment(void *)
+{
+	counter++;
+}
+
+void *run_thread(void *)
+{
+	int i;
+	for(i = 1; i <= iterations; i++) {
+		if(use_mcs) {
+			mcs_qnode_t newNode;
+			mcs_acquire(&mcslock, &newNode);
+			counter++;
+			mcs_release(&mcslock, &newNode);
+		}
+		else
+			fc_execute(&lock, increment, NULL);
+	}
+	pthread_exit(NULL);
+}
+
+//one timed run of every thread under the chosen lock
+void run_setting(bool mcs)
+{
+	pthread_t threads[NUM_THREADS];
+	int rc;
+	int i;
+	void *status;
+
+	counter = 0;
+	use_mcs = mcs;
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+
+	cout << (mcs ? "mcs" : "flat combining") << " : Counter = " << counter << endl;
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)NUM_THREADS * iterations * 1e9 / (end - start) << " ops/sec\n";
+}
+
+//the queue side of the comparison is part2: fcqueue against nonblock,
+//run with the same -t and -i
+int main(int argc, char* argv[])
+{
+	fc_init(&lock);
+
+	//default values for number of threads & iterations
+	NUM_THREADS = 4;
+	iterations  = 10000;
+	bool both = false;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m fc|mcs|both] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	//the same loop under the mcs lock, for comparison; both runs one
+	//after the other
+	if(argc >6) {
+		use_mcs = (strcmp(argv[6], "mcs") == 0);
+		both = (strcmp(argv[6], "both") == 0);
+	}
+	if(NUM_THREADS > MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS << " threads" << std::endl;
+	return 1;
+	}
+
+	if(both) {
+		run_setting(false);
+		run_setting(true);
+	}
+	else
+		run_setting(use_mcs);
+	pthread_exit(NULL);
+}
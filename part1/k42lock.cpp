@@ -0,0 +1,88 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+bool use_mcs = false;
+
+k42_mutex k42lock;
+mcs_qnode_t *mcslock = NULL;
+
+void *run_thread(void *)
+{
+	int i;
+	for(i = 1; i <= iterations; i++) {
+		if(use_mcs) {
+			mcs_qnode_t newNode;
+			mcs_acquire(&mcslock, &newNode);
+			counter++;
+			mcs_release(&mcslock, &newNode);
+		}
+		else {
+			std::lock_guard<k42_mutex> guard(k42lock);
+			counter++;
+		}
+	}
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m k42|mcs] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	//the same loop under the mcs lock, for comparison
+	if(argc >6)
+		use_mcs = (strcmp(argv[6], "mcs") == 0);
+
+	pthread_t threads[NUM_THREADS];
+	int rc;
+	int i;
+	void *status;
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+
+	cout << (use_mcs ? "mcs" : "k42 mcs") << " : Counter = " << counter << endl;
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	pthread_exit(NULL);
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+
+//which lock protects the counter: malthusian mcs (default), ticket or mcs
+enum { MODE_MCSCR, MODE_TICKET, MODE_MCS } mode = MODE_MCSCR;
+
+mcscr_lock_t mcscr;
+ticket_lock_t ticket;
+mcs_qnode_t *mcslock = NULL;
+
+void *run_thread(void *)
+{
+	int i;
+	for(i = 1; i <= iterations; i++) {
+		if(mode == MODE_MCSCR) {
+			mcs_qnode_t newNode;
+			mcscr_acquire(&mcscr, &newNode);
+			counter++;
+			mcscr_release(&mcscr, &newNode);
+		}
+		else if(mode == MODE_TICKET) {
+			ticket_acquire(&ticket);
+			counter++;
+			ticket_release(&ticket);
+		}
+		else {
+			mcs_qnode_t newNode;
+			mcs_acquire(&mcslock, &newNode);
+			counter++;
+			mcs_release(&mcslock, &newNode);
+		}
+	}
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	mcscr_init(&mcscr);
+	ticket.next_ticket = 0;
+	ticket.now_serving = 0;
+
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m mcscr|ticket|mcs] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(argc >6)
+	{
+		if(strcmp(argv[6], "ticket") == 0)
+			mode = MODE_TICKET;
+		else if(strcmp(argv[6], "mcs") == 0)
+			mode = MODE_MCS;
+	}
+
+	pthread_t threads[NUM_THREADS];
+	int rc;
+	int i;
+	void *status;
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+
+	cout << "Counter = " << counter << endl;
+	if(mode == MODE_MCSCR)
+		cout << "Waiters moved to the passive list = " << mcscr.culled << endl;
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)NUM_THREADS * iterations * 1e9 / (end - start) << " ops/sec\n";
+	pthread_exit(NULL);
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+
+//the counter is split over num_locks locks, one per slot
+int num_locks = 1;
+bool use_pthread = false;
+
+byte_lock_t *byte_locks;
+pthread_mutex_t *mutexes;
+volatile int *counters;
+
+void *run_thread(void *threadid)
+{
+	long tid;
+	tid = (long)threadid;
+	int i;
+	for(i = 1; i <= iterations; i++) {
+		int l = (i + tid) % num_locks;
+		if(use_pthread) {
+			pthread_mutex_lock(&mutexes[l]);
+			counters[l]++;
+			pthread_mutex_unlock(&mutexes[l]);
+		}
+		else {
+			byte_lock_acquire(&byte_locks[l]);
+			counters[l]++;
+			byte_lock_release(&byte_locks[l]);
+		}
+	}
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-l num_locks] [-m byte|pthread] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(argc >6)
+		num_locks = atoi(argv[6]);
+	if(argc >8)
+		use_pthread = (strcmp(argv[8], "pthread") == 0);
+	if(num_locks < 1)
+		num_locks = 1;
+
+	pthread_t threads[NUM_THREADS];
+	int rc;
+	int i;
+	void *status;
+
+	counters = (volatile int *)calloc(num_locks, sizeof(int));
+	if(use_pthread) {
+		mutexes = (pthread_mutex_t *)malloc(num_locks * sizeof(pthread_mutex_t));
+		for( i=0; i < num_locks; i++ )
+			pthread_mutex_init(&mutexes[i], 0);
+	}
+	else
+		byte_locks = (byte_lock_t *)calloc(num_locks, sizeof(byte_lock_t));
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+
+	for( i=0; i < num_locks; i++ )
+		counter += counters[i];
+
+	size_t lock_size = use_pthread ? sizeof(pthread_mutex_t) : sizeof(byte_lock_t);
+	cout << (use_pthread ? "pthread_mutex_t" : "byte lock") << " : Counter = " << counter << endl;
+	cout << "Memory = " << lock_size << " bytes per lock, "
+	     << lock_size * num_locks << " bytes for " << num_locks << " locks";
+	if(!use_pthread)
+		cout << " + " << sizeof(parking_table) << " bytes of shared parking lot";
+	cout << endl;
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)NUM_THREADS * iterations * 1e9 / (end - start) << " ops/sec\n";
+	pthread_exit(NULL);
+}
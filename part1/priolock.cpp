@@ -0,0 +1,147 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+
+//threads [0, num_high) are latency critical (class 0), the rest are batch
+int num_high = 1;
+
+//which lock protects the counter: priority (default), ticket or mcs
+enum { MODE_PRIO, MODE_TICKET, MODE_MCS } mode = MODE_PRIO;
+
+prio_lock_t prio;
+ticket_lock_t ticket;
+mcs_qnode_t *mcslock = NULL;
+
+//acquire latencies of each thread, in nsec
+vector<double> *latency;
+
+void *run_thread(void *threadid)
+{
+	long tid;
+	tid = (long)threadid;
+	int i;
+	int cls = (tid < num_high) ? 0 : 1;
+	for(i = 1; i <= iterations; i++) {
+		double start = getElapsedTime();
+		if(mode == MODE_PRIO) {
+			prio_qnode_t newNode;
+			prio_acquire(&prio, &newNode, cls);
+			latency[tid].push_back(getElapsedTime() - start);
+			counter++;
+			prio_release(&prio);
+		}
+		else if(mode == MODE_TICKET) {
+			ticket_acquire(&ticket);
+			latency[tid].push_back(getElapsedTime() - start);
+			counter++;
+			ticket_release(&ticket);
+		}
+		else {
+			mcs_qnode_t newNode;
+			mcs_acquire(&mcslock, &newNode);
+			latency[tid].push_back(getElapsedTime() - start);
+			counter++;
+			mcs_release(&mcslock, &newNode);
+		}
+	}
+	pthread_exit(NULL);
+}
+
+//print p50/p90/p99/max acquire latency of threads [first, last)
+void report(const char *name, int first, int last)
+{
+	vector<double> all;
+	for(int t = first; t < last; t++)
+		all.insert(all.end(), latency[t].begin(), latency[t].end());
+	if(all.empty())
+		return;
+	sort(all.begin(), all.end());
+	cout << name << " (" << last - first << " threads) acquire latency nsec :"
+	     << " p50 " << all[all.size() * 50 / 100]
+	     << " p90 " << all[all.size() * 90 / 100]
+	     << " p99 " << all[all.size() * 99 / 100]
+	     << " max " << all.back() << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	prio_init(&prio);
+	ticket.next_ticket = 0;
+	ticket.now_serving = 0;
+
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-h high_priority_threads] [-m prio|ticket|mcs] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(argc >6)
+		num_high = atoi(argv[6]);
+	if(argc >8)
+	{
+		if(strcmp(argv[8], "ticket") == 0)
+			mode = MODE_TICKET;
+		else if(strcmp(argv[8], "mcs") == 0)
+			mode = MODE_MCS;
+	}
+	if(num_high > NUM_THREADS)
+		num_high = NUM_THREADS;
+
+	pthread_t threads[NUM_THREADS];
+	int rc;
+	int i;
+	void *status;
+
+	latency = new vector<double>[NUM_THREADS];
+	for( i=0; i < NUM_THREADS; i++ )
+		latency[i].reserve(iterations);
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < NUM_THREADS; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+
+	cout << "Counter = " << counter << endl;
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	report("high priority", 0, num_high);
+	report("low priority", num_high, NUM_THREADS);
+	delete[] latency;
+	pthread_exit(NULL);
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+static volatile int counter = 0;
+int iterations;
+
+//which lock protects the counter: reactive (default), tatas or mcs
+enum { MODE_REACTIVE, MODE_TATAS, MODE_MCS } mode = MODE_REACTIVE;
+
+reactive_lock_t reactive;
+tatas_lock_t flag = 0;
+mcs_qnode_t *mcslock = NULL;
+
+void *run_thread(void *)
+{
+	int i;
+	for(i = 1; i <= iterations; i++) {
+		if(mode == MODE_REACTIVE) {
+			reactive_acquire(&reactive);
+			counter++;
+			reactive_release(&reactive);
+		}
+		else if(mode == MODE_TATAS) {
+			tatas_acquire(&flag);
+			counter++;
+			tatas_release(&flag);
+		}
+		else {
+			mcs_qnode_t newNode;
+			mcs_acquire(&mcslock, &newNode);
+			counter++;
+			mcs_release(&mcslock, &newNode);
+		}
+	}
+	pthread_exit(NULL);
+}
+
+//run one phase of the benchmark with the given number of threads
+void run_phase(int phase, int nthreads)
+{
+	pthread_t threads[nthreads];
+	int rc;
+	int i;
+	void *status;
+
+	//timers
+	double start, end;
+	start = getElapsedTime();
+
+	//creating the threads
+	for( i=0; i < nthreads; i++ ){
+		rc = pthread_create(&threads[i], NULL, run_thread, (void *)(long)i );
+		if (rc){
+		  cout << "Error:unable to create thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//wait for the other threads
+	for( i=0; i < nthreads; i++ ){
+		rc = pthread_join(threads[i], &status);
+		if (rc){
+		 cout << "Error:unable to join," << rc << endl;
+		 exit(-1);
+		}
+	}
+	end = getElapsedTime();
+
+	cout << "Phase " << phase << " : " << nthreads << " threads, "
+	     << "Execution time =" << (end - start) << " nsec";
+	if(mode == MODE_REACTIVE)
+		cout << ", mode = " << (reactive.mode == REACTIVE_TAS ? "tas" : "queue")
+		     << ", switches = " << reactive.switches;
+	cout << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	reactive_init(&reactive);
+
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m reactive|tatas|mcs] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+	if(argc >4)
+	{
+	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(argc >6)
+	{
+		if(strcmp(argv[6], "tatas") == 0)
+			mode = MODE_TATAS;
+		else if(strcmp(argv[6], "mcs") == 0)
+			mode = MODE_MCS;
+	}
+
+	//the load swings from one thread to all of them and back, so the
+	//reactive lock has to change protocol twice
+	run_phase(1, 1);
+	run_phase(2, NUM_THREADS);
+	run_phase(3, 1);
+
+	cout << "Counter = " << counter << endl;
+	pthread_exit(NULL);
+}
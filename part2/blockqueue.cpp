@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include<assert.h>
+#include<stdlib.h>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+int iterations;
+
+//how consumers wait for work: futex semaphore (default), futex condition
+//variable, pthread_cond_t, or spinning on an empty dequeue
+enum { MODE_SEM, MODE_COND, MODE_PTHREAD, MODE_SPIN } mode = MODE_SEM;
+
+typedef struct __node_t {
+ 	int value;
+ 	struct __node_t *next;
+ } node_t;
+
+ typedef struct __queue_t {
+	node_t *head;
+ 	node_t *tail;
+ } queue_t;
+
+queue_t myQ;
+tatas_mutex qlock;
+fsem_t items;
+fcond_t nonempty;
+pthread_mutex_t myMutex;
+pthread_cond_t myCond;
+
+int num_producers;
+int num_consumers;
+
+//sum of the values each consumer dequeued, to check that nothing was lost
+unsigned long long *sums;
+
+ //intialize queue
+ void Queue_Init(queue_t *q) {
+ 	node_t *tmp = (node_t *)malloc(sizeof(node_t));      // Allocate a free node
+ 	tmp->next = NULL;                                    // Make it the only node in the linked list
+ 	q->head = q->tail = tmp;                             // Both Head and Tail point to it
+ }
+
+ //sequential enqueue; the caller holds the queue lock
+ void Queue_Enqueue(queue_t *q, node_t *tmp) {
+ 	q->tail->next = tmp;                                 // Link node at the end of the linked list
+	q->tail = tmp;                                       // Swing Tail to node
+ }
+
+ //sequential dequeue; returns the old dummy node, or NULL if empty
+ node_t *Queue_Dequeue(queue_t *q, int *value) {
+ 	node_t *tmp = q->head;                               // Read Head
+ 	node_t *newHead = tmp->next;                         // Read next pointer
+ 	if (newHead == NULL)                                 // Is queue empty?
+		return NULL;
+	*value = newHead->value;                             // Queue not empty.  Read value
+ 	q->head = newHead;                                   // Swing Head to next node
+	return tmp;
+ }
+
+ //add one item and wake a consumer
+ void produce(int value) {
+	node_t *tmp = (node_t *)malloc(sizeof(node_t));       // Allocate outside the critical section
+ 	assert(tmp != NULL);
+ 	tmp->value = value;
+ 	tmp->next = NULL;
+	if (mode == MODE_PTHREAD) {
+		pthread_mutex_lock(&myMutex);
+		Queue_Enqueue(&myQ, tmp);
+		pthread_cond_signal(&myCond);
+		pthread_mutex_unlock(&myMutex);
+		return;
+	}
+	qlock.lock();
+	Queue_Enqueue(&myQ, tmp);
+	if (mode == MODE_COND)
+		fcond_signal(&nonempty);
+	qlock.unlock();
+	if (mode == MODE_SEM)
+		fsem_post(&items);
+ }
+
+ //take one item, waiting until there is one
+ int consume() {
+	node_t *tmp;
+	int value;
+	if (mode == MODE_PTHREAD) {
+		pthread_mutex_lock(&myMutex);
+		while ((tmp = Queue_Dequeue(&myQ, &value)) == NULL)
+			pthread_cond_wait(&myCond, &myMutex);
+		pthread_mutex_unlock(&myMutex);
+	}
+	else if (mode == MODE_COND) {
+		qlock.lock();
+		while ((tmp = Queue_Dequeue(&myQ, &value)) == NULL)
+			fcond_wait(&nonempty, qlock);
+		qlock.unlock();
+	}
+	else {
+		//the semaphore counts queued items, so the dequeue cannot fail
+		if (mode == MODE_SEM)
+			fsem_wait(&items);
+		for (;;) {
+			qlock.lock();
+			tmp = Queue_Dequeue(&myQ, &value);
+			qlock.unlock();
+			if (tmp != NULL)
+				break;
+		}
+	}
+ 	free(tmp);                                           // Free the old dummy node
+	return value;
+ }
+
+void *producer(void *)
+{
+	int i;
+ 	for(i = 1; i <= iterations; i++)
+		produce(i);
+	pthread_exit(NULL);
+}
+
+void *consumer(void *threadid)
+{
+	int c;
+   	c = (int)(long)threadid - num_producers;
+	//split the produced items evenly over the consumers
+	long n = (long)num_producers * iterations;
+	long mine = n / num_consumers + (c < n % num_consumers ? 1 : 0);
+	unsigned long long sum = 0;
+	long i;
+	for(i = 0; i < mine; i++)
+		sum += consume();
+	sums[c] = sum;
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	Queue_Init(&myQ);
+	fsem_init(&items, 0);
+	fcond_init(&nonempty);
+	pthread_mutex_init(&myMutex, 0);
+	pthread_cond_init(&myCond, 0);
+
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m sem|cond|pthread|spin] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+        if(argc >4)
+	{
+   	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(argc >6)
+	{
+		if(strcmp(argv[6], "cond") == 0)
+			mode = MODE_COND;
+		else if(strcmp(argv[6], "pthread") == 0)
+			mode = MODE_PTHREAD;
+		else if(strcmp(argv[6], "spin") == 0)
+			mode = MODE_SPIN;
+	}
+	if(NUM_THREADS < 2)
+		NUM_THREADS = 2;
+	//the first half of the threads produce, the rest consume
+	num_producers = NUM_THREADS / 2;
+	num_consumers = NUM_THREADS - num_producers;
+
+	sums = new unsigned long long[num_consumers];
+	pthread_t threads[NUM_THREADS];
+   	int rc;
+   	int i;
+	void *status;
+
+	//timers
+   	double start, end;
+   	start = getElapsedTime();
+
+	//creating the threads
+  	 for( i=0; i < NUM_THREADS; i++ ){
+    	  	rc = pthread_create(&threads[i], NULL, i < num_producers ? producer : consumer, (void *)(long)i );
+    	  	if (rc){
+     	  	  cout << "Error:unable to create thread," << rc << endl;
+       	  	  exit(-1);
+   	  	}
+ 	  }
+
+        // wait for the other threads
+   	for( i=0; i < NUM_THREADS; i++ ){
+      		rc = pthread_join(threads[i], &status);
+      		if (rc){
+        	 cout << "Error:unable to join," << rc << endl;
+       		 exit(-1);
+      		}
+   	}
+	end = getElapsedTime();
+
+	unsigned long long total = 0;
+	for( i=0; i < num_consumers; i++ )
+		total += sums[i];
+	unsigned long long expected = (unsigned long long)num_producers * iterations * (iterations + 1) / 2;
+	cout << num_producers << " producers, " << num_consumers << " consumers : "
+	     << (total == expected ? "all items consumed" : "ITEMS LOST") << endl;
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)num_producers * iterations * 1e9 / (end - start) << " items/sec\n";
+        pthread_mutex_destroy(&myMutex);
+        pthread_cond_destroy(&myCond);
+	delete[] sums;
+        pthread_exit(NULL);
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include<assert.h>
+#include<stdlib.h>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+int iterations;
+
+//which lock protects the queue: delegation (default), ticket or mcs
+enum { MODE_DL, MODE_TICKET, MODE_MCS } mode = MODE_DL;
+
+typedef struct __node_t {
+ 	int value;
+ 	struct __node_t *next;
+ } node_t;
+
+ typedef struct __queue_t {
+	node_t *head;
+ 	node_t *tail;
+ } queue_t;
+
+queue_t myQ;
+dl_server_t server;
+ticket_lock_t ticket;
+mcs_qnode_t *mcslock = NULL;
+
+ //intialize queue
+ void Queue_Init(queue_t *q) {
+ 	node_t *tmp = (node_t *)malloc(sizeof(node_t));      // Allocate a free node
+ 	tmp->next = NULL;                                    // Make it the only node in the linked list
+ 	q->head = q->tail = tmp;                             // Both Head and Tail point to it
+ }
+
+ //sequential enqueue; the caller provides the mutual exclusion
+ unsigned long enq_op(void *arg) {
+	node_t *tmp = (node_t *)arg;
+ 	myQ.tail->next = tmp;                                // Link node at the end of the linked list
+	myQ.tail = tmp;                                      // Swing Tail to node
+	return 0;
+ }
+
+ //sequential dequeue; returns the old dummy node, or NULL if empty
+ unsigned long deq_op(void *arg) {
+ 	node_t *tmp = myQ.head;                              // Read Head
+ 	node_t *newHead = tmp->next;                         // Read next pointer
+ 	if (newHead == NULL)                                 // Is queue empty?
+		return 0;
+	*(int *)arg = newHead->value;                        // Queue not empty.  Read value
+ 	myQ.head = newHead;                                  // Swing Head to next node
+	return (unsigned long)tmp;
+ }
+
+ //run one queue operation under the selected lock
+ unsigned long Queue_Op(unsigned long (*op)(void *), void *arg) {
+	unsigned long ret;
+	if (mode == MODE_DL)
+		return dl_execute(&server, op, arg);
+	if (mode == MODE_TICKET) {
+		ticket_acquire(&ticket);
+		ret = op(arg);
+		ticket_release(&ticket);
+	}
+	else {
+		mcs_qnode_t newNode;
+		mcs_acquire(&mcslock, &newNode);
+		ret = op(arg);
+		mcs_release(&mcslock, &newNode);
+	}
+	return ret;
+ }
+
+ //adding to queue
+ void Queue_Enqueue(int value) {
+	node_t *tmp = (node_t *)malloc(sizeof(node_t));       // Allocate outside the critical section
+ 	assert(tmp != NULL);
+ 	tmp->value = value;
+ 	tmp->next = NULL;
+	Queue_Op(enq_op, tmp);
+ }
+
+ //Dequeue
+ int Queue_Dequeue(int *value) {
+	node_t *tmp = (node_t *)Queue_Op(deq_op, value);
+	if (tmp == NULL)
+		return -1;                                   // if the queue was empty
+ 	free(tmp);                                           // Free the old dummy node
+	return 0;
+ }
+
+int generateProb()
+{
+    return rand( ) % 2;
+}
+
+void *server_thread(void *)
+{
+	dl_serve(&server);
+	pthread_exit(NULL);
+}
+
+void *my_loop(void *)
+{
+        int i;
+	int prob = generateProb();
+	int val;
+
+ 	for(i = 1; i <= iterations; i++) {
+       		 if(prob == 0)
+        	    Queue_Enqueue(i);
+      		 else
+ 		    Queue_Dequeue(&val);
+	}
+
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	Queue_Init(&myQ);
+	dl_init(&server);
+	ticket.next_ticket = 0;
+	ticket.now_serving = 0;
+
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m dl|ticket|mcs] -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+        if(argc >4)
+	{
+   	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(argc >6)
+	{
+		if(strcmp(argv[6], "ticket") == 0)
+			mode = MODE_TICKET;
+		else if(strcmp(argv[6], "mcs") == 0)
+			mode = MODE_MCS;
+	}
+	if(NUM_THREADS > MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS << " threads" << std::endl;
+	return 1;
+	}
+	pthread_t threads[NUM_THREADS];
+	pthread_t server_tid;
+   	int rc;
+   	int i;
+	void *status;
+
+	//the server owns the queue for the whole run
+	if(mode == MODE_DL) {
+		rc = pthread_create(&server_tid, NULL, server_thread, NULL);
+		if (rc){
+		  cout << "Error:unable to create server thread," << rc << endl;
+		  exit(-1);
+		}
+	}
+
+	//timers
+   	double start, end;
+   	start = getElapsedTime();
+
+	//creating the threads
+  	 for( i=0; i < NUM_THREADS; i++ ){
+    	  	rc = pthread_create(&threads[i], NULL, my_loop, (void *)(long)i );
+    	  	if (rc){
+     	  	  cout << "Error:unable to create thread," << rc << endl;
+       	  	  exit(-1);
+   	  	}
+ 	  }
+
+        // wait for the other threads
+   	for( i=0; i < NUM_THREADS; i++ ){
+      		rc = pthread_join(threads[i], &status);
+      		if (rc){
+        	 cout << "Error:unable to join," << rc << endl;
+       		 exit(-1);
+      		}
+   	}
+	end = getElapsedTime();
+
+	if(mode == MODE_DL) {
+		dl_stop(&server);
+		pthread_join(server_tid, &status);
+	}
+
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)NUM_THREADS * iterations * 1e9 / (end - start) << " ops/sec\n";
+        pthread_exit(NULL);
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include<assert.h>
+#include<stdlib.h>
+#include <iostream>
+#include <cstdlib>
+#include <pthread.h>
+#include "atomic_ops.h"
+#include "hrtime.h"
+
+using namespace std;
+
+int iterations;
+
+typedef struct __node_t {
+ 	int value;
+ 	struct __node_t *next;
+ } node_t;
+
+ typedef struct __queue_t {
+	node_t *head;
+ 	node_t *tail;
+	//every operation on the queue goes through the combiner
+	fc_lock_t fc;
+ } queue_t;
+
+ //one enqueue or dequeue request, as published to the combiner
+ typedef struct __queue_req_t {
+	queue_t *q;
+	int value;
+	int result;
+ } queue_req_t;
+
+queue_t myQ;
+
+ //intialize queue
+ void Queue_Init(queue_t *q) {
+ 	node_t *tmp = (node_t *)malloc(sizeof(node_t));      // Allocate a free node
+ 	tmp->next = NULL;                                    // Make it the only node in the linked list
+ 	q->head = q->tail = tmp;                             // Both Head and Tail point to it
+	fc_init(&q->fc);
+ }
+
+ //sequential enqueue, only ever run by the combiner
+ void enq_op(void *arg) {
+	queue_req_t *req = (queue_req_t *)arg;
+	node_t *tmp = (node_t *)malloc(sizeof(node_t));
+ 	assert(tmp != NULL);
+ 	tmp->value = req->value;
+ 	tmp->next = NULL;
+ 	req->q->tail->next = tmp;                             // Link node at the end of the linked list
+	req->q->tail = tmp;                                   // Swing Tail to node
+	req->result = 0;
+ }
+
+ //sequential dequeue, only ever run by the combiner
+ void deq_op(void *arg) {
+	queue_req_t *req = (queue_req_t *)arg;
+ 	node_t *tmp = req->q->head;                          // Read Head
+ 	node_t *newHead = tmp->next;                         // Read next pointer
+ 	if (newHead == NULL) {                               // Is queue empty?
+		req->result = -1;
+		return;
+ 	}
+ 	req->value = newHead->value;                         // Queue not empty.  Read value
+ 	req->q->head = newHead;                              // Swing Head to next node
+ 	free(tmp);
+	req->result = 0;
+ }
+
+ //adding to queue
+ void Queue_Enqueue(queue_t *q, int value) {
+	queue_req_t req;
+	req.q = q;
+	req.value = value;
+	fc_execute(&q->fc, enq_op, &req);
+ }
+
+ //Dequeue
+ int Queue_Dequeue(queue_t *q, int *value) {
+	queue_req_t req;
+	req.q = q;
+	fc_execute(&q->fc, deq_op, &req);
+	if (req.result == 0)
+		*value = req.value;
+	return req.result;
+ }
+
+int generateProb()
+{
+    return rand( ) % 2;
+}
+
+
+void *my_loop(void *)
+{
+        int i;
+	int prob = generateProb();
+	int val;
+
+ 	for(i = 1; i <= iterations; i++) {
+       		 if(prob == 0)
+        	    Queue_Enqueue(&myQ, i);
+      		 else
+ 		    Queue_Dequeue(&myQ, &val);
+	}
+
+	pthread_exit(NULL);
+}
+
+int main(int argc, char* argv[])
+{
+	Queue_Init(&myQ);
+
+	//default values for number of threads & iterations
+	int NUM_THREADS = 4;
+	iterations      = 10000;
+
+	if(argc <1)
+	{
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter -lpthread" <<std::endl;
+	return 1;
+	}
+	//Setting the user defined number of threads & iterations
+        if(argc >4)
+	{
+   	NUM_THREADS     = atoi(argv[2]);
+	iterations      = atoi(argv[4]);
+	}
+	if(NUM_THREADS > MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS << " threads" << std::endl;
+	return 1;
+	}
+	pthread_t threads[NUM_THREADS];
+   	int rc;
+   	int i;
+	void *status;
+
+	//timers
+   	double start, end;
+   	start = getElapsedTime();
+
+	//creating the threads
+  	 for( i=0; i < NUM_THREADS; i++ ){
+    	  	rc = pthread_create(&threads[i], NULL, my_loop, (void *)(long)i );
+    	  	if (rc){
+     	  	  cout << "Error:unable to create thread," << rc << endl;
+       	  	  exit(-1);
+   	  	}
+ 	  }
+
+        // wait for the other threads
+   	for( i=0; i < NUM_THREADS; i++ ){
+      		rc = pthread_join(threads[i], &status);
+      		if (rc){
+        	 cout << "Error:unable to join," << rc << endl;
+       		 exit(-1);
+      		}
+   	}
+	end = getElapsedTime();
+
+	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)NUM_THREADS * iterations * 1e9 / (end - start) << " ops/sec\n";
+        pthread_exit(NULL);
+}
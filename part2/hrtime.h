@@ -35,7 +35,7 @@
 #ifndef __HRTIME_H__
 #define __HRTIME_H__
 
-#if defined(__i386__) && !defined(__APPLE__) && !defined(_MSC_VER)
+#if (defined(__i386__) || defined(__x86_64__)) && !defined(__APPLE__) && !defined(_MSC_VER)
 // gethrtime implementation by Kai Shen for x86 Linux
 
 #ifdef __linux__
@@ -111,7 +111,7 @@ inline unsigned long long getElapsedTime()
         CPU_MHZ = getMHZ_x86();
     return (unsigned long long)(gethrcycle_x86() * 1000 / CPU_MHZ);
 }
-#endif // i386
+#endif // i386 || x86_64
 
 #if defined(__linux__) && defined(__ia64__)
 
@@ -3,8 +3,11 @@
 #include<stdlib.h>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <inttypes.h>
 #include <pthread.h>
+#include <sys/resource.h>
+#include "atomic_ops.h"
 #include "hrtime.h"
 
 using namespace std;
@@ -13,16 +16,30 @@ typedef bool bool_t;
 typedef intptr_t lkey_t;
 typedef intptr_t  val_t;
 
+/*
+ * A counted pointer is swung with one double-width CAS: cmpxchg8b on
+ * 32-bit x86, cmpxchg16b on x86-64.  cmpxchg16b faults unless its operand
+ * is 16-byte aligned, so the pair is aligned to its own size rather than
+ * packed; count comes first because the instructions compare it against
+ * the low half, in eax/rax.  The halves are volatile, and read through
+ * read_ptr(), so that the re-reads of head and tail that validate a
+ * snapshot really happen; otherwise deq can follow a head that was
+ * already freed.
+ */
+#if defined(__x86_64__) && !defined(_X86_64_)
+#define _X86_64_
+#endif
+
 typedef struct _pointer_t {
-  intptr_t count;
-  struct _node_t *ptr;
-}__attribute__((packed)) pointer_t;
+  volatile intptr_t count;
+  struct _node_t * volatile ptr;
+}__attribute__((aligned(2 * sizeof(intptr_t)))) pointer_t;
 
 typedef struct _node_t {
 
   pointer_t next;
   val_t val;
-}__attribute__((packed)) node_t;
+} node_t;
 
 
 typedef struct _queue_t
@@ -31,10 +48,124 @@ typedef struct _queue_t
   pointer_t tail;
 } queue_t;
 
-queue_t * init_queue (void);
+/*
+ * With epoch-based reclamation or hazard pointers no node is reused while
+ * a thread may still hold a pointer to it, so there is no ABA problem and
+ * the links can be plain pointers swung with a single-word CAS.
+ */
+typedef struct _enode_t {
+  struct _enode_t * volatile next;
+  val_t val;
+} enode_t;
+
+typedef struct _equeue_t
+{
+  enode_t * volatile head;
+  enode_t * volatile tail;
+} equeue_t;
+
+/*
+ * In index mode the nodes live in one preallocated array and a link is a
+ * 32-bit array index with a 32-bit tag above it in a single 64-bit word,
+ * so head, tail and next are swung with a plain 64-bit CAS instead of a
+ * double-width one.  Index 0 is never handed out and stands for NULL.
+ * Every write to a link bumps its tag, so a stale CAS cannot succeed
+ * unless the tag wraps all the way around in between.
+ */
+typedef unsigned long long ilink_t;
+
+#define ILINK(idx, tag)	(((ilink_t)(tag) << 32) | (ilink_t)(idx))
+#define ILINK_IDX(l)	((unsigned int)(l))
+#define ILINK_TAG(l)	((unsigned int)((l) >> 32))
+#define INIL		0
+
+typedef struct _inode_t {
+  volatile ilink_t next;
+  val_t val;
+} inode_t;
+
+typedef struct _iqueue_t
+{
+  volatile ilink_t head;
+  volatile ilink_t tail;
+} iqueue_t;
+
+/*
+ * The same three queues with head and tail on cache lines of their own,
+ * so that enqueuers swinging the tail do not keep invalidating the line
+ * that dequeuers read the head from.  The queue functions are templates
+ * over the queue type, and -l picks one layout or the other.
+ */
+typedef struct _padded_queue_t
+{
+  pointer_t head;
+  pointer_t tail __attribute__((aligned(CACHELINE_BYTES)));
+} __attribute__((aligned(CACHELINE_BYTES))) padded_queue_t;
+
+typedef struct _padded_equeue_t
+{
+  enode_t * volatile head;
+  enode_t * volatile tail __attribute__((aligned(CACHELINE_BYTES)));
+} __attribute__((aligned(CACHELINE_BYTES))) padded_equeue_t;
+
+typedef struct _padded_iqueue_t
+{
+  volatile ilink_t head;
+  volatile ilink_t tail __attribute__((aligned(CACHELINE_BYTES)));
+} __attribute__((aligned(CACHELINE_BYTES))) padded_iqueue_t;
+
+//how dequeued nodes are given back: tagged pointers and an immediate
+//free (default), epoch-based reclamation, hazard pointers, or back to
+//the free list of the preallocated node array.  RECLAIM_RING has no nodes
+//at all: it runs the bounded MPMC ring from atomic_ops.h instead, and
+//RECLAIM_SPSC runs pairs of threads over SPSC rings of their own.
+//RECLAIM_FAA runs the FAA segment queue, which reclaims by epochs itself
+enum { RECLAIM_TAGGED, RECLAIM_EPOCH, RECLAIM_HAZARD, RECLAIM_INDEX, RECLAIM_RING,
+       RECLAIM_SPSC, RECLAIM_FAA } reclaim = RECLAIM_TAGGED;
+
+faa_queue_t faaq;
+
+//with -p the first producers threads only enqueue and the rest only
+//dequeue; otherwise each thread picks one side at random
+int producers = -1;
+
+//the ring, and how many enqueues the ring or the index mode's node array
+//turned away for being full
+mpmc_ring_t ring;
+volatile unsigned long enq_refused = 0;
+
+//what went into the queue and what came out, added up by each thread
+//under myMutex; whatever is left at the end is drained by main, so both
+//counts and both sums must match unless an item was lost or repeated
+unsigned long long items_in = 0, items_out = 0;
+unsigned long long sum_in = 0, sum_out = 0;
+
+//capacity from -c: the ring size, or the node count in index mode; 0 for
+//each mode's default.  Larger rings than this would not fit in a 32-bit
+//address space
+#define RING_MAX_CAPACITY (1UL << 24)
+unsigned long ring_capacity = 0;
+
+//pairwise mode: thread 2k feeds thread 2k+1 through spsc[k], and each
+//consumer adds up what it got so lost or repeated items show
+spsc_ring_t *spsc;
+unsigned long long *pair_sum;
+ebr_domain_t ebr;
+hp_domain_t hp;
+
+//where nodes come from: malloc (default) or per-thread pools
+bool use_pool = false;
+pool_t node_pool;
+pool_t enode_pool;
+
+//packed (default): both queue ends in one cache line and nodes back to
+//back; padded: each end and each node on cache lines of its own
+enum { LAYOUT_PACKED, LAYOUT_PADDED } layout = LAYOUT_PACKED;
+
+template<class Q> Q * init_queue (void);
 void free_queue (queue_t *);
-bool_t enq (queue_t *, const val_t);
-bool_t deq (queue_t *, val_t *);
+template<class Q> bool_t enq (Q *, const val_t);
+template<class Q> bool_t deq (Q *, val_t *);
 
 void show_queue(queue_t *);
 static volatile int counter = 0;
@@ -44,41 +175,90 @@ pthread_mutex_t myMutex;
 
 static node_t *create_node(const val_t);
 static void free_node(node_t *);
-bool_t enq (queue_t *, const val_t);
-bool_t deq (queue_t *, val_t *);
 
+//the space a node takes: its struct, or whole cache lines when padded
+static size_t node_bytes(size_t size)
+{
+    if (layout == LAYOUT_PACKED)
+	return size;
+    return (size + CACHELINE_BYTES - 1) & ~(size_t)(CACHELINE_BYTES - 1);
+}
+
+//a zeroed block that starts on a cache line
+static void *alloc_line(size_t size)
+{
+    void *p;
+
+    if (posix_memalign(&p, CACHELINE_BYTES, size))
+	return NULL;
+    memset(p, 0, size);
+    return p;
+}
 
+//a zeroed queue header: the padded types need their cache-line alignment,
+//the packed ones come from calloc like the nodes
+static void *alloc_queue(size_t size)
+{
+    if (layout == LAYOUT_PACKED)
+	return calloc(1, size);
+    return alloc_line(size);
+}
+
+
+//on failure the instruction loads the current value into edx:eax, so
+//those registers are outputs as well as inputs
 static inline bool_t
 #ifdef _X86_64_
 cas(volatile pointer_t * addr, pointer_t oldp, const pointer_t newp)
 {
     char result;
-  __asm__ __volatile__("lock; cmpxchg16b %0; setz %1":"=m"(*addr),
-		       "=q"(result)
-		       :"m"(*addr), "a"(oldp.count), "d"(oldp.ptr),
-		       "b"(newp.count), "c"(newp.ptr)
+  __asm__ __volatile__("lock; cmpxchg16b %0; setz %1":"+m"(*addr),
+		       "=q"(result), "+a"(oldp.count), "+d"(oldp.ptr)
+		       :"b"(newp.count), "c"(newp.ptr)
 		       :"memory");
   return (((int)result == 0) ? false:true);
 }
 #else
-cas(volatile pointer_t * addr, const pointer_t oldp, const pointer_t newp)
+cas(volatile pointer_t * addr, pointer_t oldp, const pointer_t newp)
 {
     char result;
-  __asm__ __volatile__("lock; cmpxchg8b %0; setz %1":"=m"(*addr),
-		       "=q"(result)
-		       :"m"(*addr), "a"(oldp.count), "d"(oldp.ptr),
-			"b"(newp.count), "c"(newp.ptr)
+  __asm__ __volatile__("lock; cmpxchg8b %0; setz %1":"+m"(*addr),
+		       "=q"(result), "+a"(oldp.count), "+d"(oldp.ptr)
+			:"b"(newp.count), "c"(newp.ptr)
 		       :"memory");
   return (((int)result == 0) ? false:true);
 }
 #endif
 
 
+//copy a counted pointer one half at a time.  A plain struct copy is a
+//trivial copy, which the compiler may do once and reuse, volatile or not
+static inline pointer_t read_ptr(pointer_t * p)
+{
+    pointer_t r;
+    r.count = p->count;
+    r.ptr = p->ptr;
+    return r;
+}
+
 static node_t *create_node(const val_t val)
 {
     node_t *node;
 
-    if ((node = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
+    if (use_pool) {
+	//a pooled node keeps its tag from its last use, so reusing it
+	//does not bring an old counted pointer back
+	node = (node_t *) pool_alloc(&node_pool);
+	node->val = val;
+	node->next.ptr = NULL;
+	return node;
+    }
+
+    if (layout == LAYOUT_PACKED)
+	node = (node_t *) calloc(1, sizeof(node_t));
+    else
+	node = (node_t *) alloc_line(node_bytes(sizeof(node_t)));
+    if (node == NULL) {
 	return NULL;
     }
 
@@ -92,16 +272,20 @@ static node_t *create_node(const val_t val)
 static void free_node(node_t * node)
 {
 
-    free(node);
+    if (use_pool)
+	pool_free(&node_pool, node);
+    else
+	free(node);
 
 }
 
-queue_t *init_queue(void)
+template<class Q>
+Q *init_queue(void)
 {
-    queue_t *q;
+    Q *q;
     node_t *node;
 
-    if ((q = (queue_t *) calloc(1, sizeof(queue_t))) == NULL) {
+    if ((q = (Q *) alloc_queue(sizeof(Q))) == NULL) {
 	return NULL;
     }
 
@@ -109,6 +293,10 @@ queue_t *init_queue(void)
       abort();
     }
 
+    //calloc, alloc_line and the pool all return blocks aligned for the DWCAS
+    assert(((uintptr_t)&q->head & (sizeof(pointer_t) - 1)) == 0);
+    assert(((uintptr_t)&node->next & (sizeof(pointer_t) - 1)) == 0);
+
     q->head.ptr = node;
     q->tail.ptr = node;
 
@@ -120,7 +308,8 @@ void free_queue(queue_t * q)
   free(q);
 }
 
-bool_t enq(queue_t * q, const val_t val)
+template<class Q>
+bool_t enq(Q * q, const val_t val)
 {
     node_t *newNode;
     pointer_t tail, next, tmp;
@@ -129,8 +318,8 @@ bool_t enq(queue_t * q, const val_t val)
 	return false;
 
     while (1) {
-	tail = q->tail;
-	next = tail.ptr->next;
+	tail = read_ptr(&q->tail);
+	next = read_ptr(&tail.ptr->next);
 
 	if (tail.count == q->tail.count && tail.ptr == q->tail.ptr) {
 	  if (next.ptr == NULL) {
@@ -153,14 +342,15 @@ bool_t enq(queue_t * q, const val_t val)
     return true;
 }
 
-bool_t deq(queue_t * q, val_t * val)
+template<class Q>
+bool_t deq(Q * q, val_t * val)
 {
   pointer_t head, tail, next, tmp;
  
     while (1) {
-	head = q->head;
-	tail = q->tail;
-	next = head.ptr->next;
+	head = read_ptr(&q->head);
+	tail = read_ptr(&q->tail);
+	next = read_ptr(&head.ptr->next);
 
 	if (head.count == q->head.count && head.ptr == q->head.ptr) {
 	  if (head.ptr == tail.ptr) {
@@ -187,6 +377,347 @@ bool_t deq(queue_t * q, val_t * val)
 }
 
 
+static inline bool_t
+ptr_cas(enode_t * volatile * addr, enode_t * oldp, enode_t * newp)
+{
+  return bool_cas((volatile unsigned long *)addr,
+		  (unsigned long)oldp, (unsigned long)newp);
+}
+
+static enode_t *create_enode(const val_t val)
+{
+    enode_t *node;
+
+    if (use_pool)
+	node = (enode_t *) pool_alloc(&enode_pool);
+    else if (layout == LAYOUT_PACKED)
+	node = (enode_t *) malloc(sizeof(enode_t));
+    else
+	node = (enode_t *) alloc_line(node_bytes(sizeof(enode_t)));
+    if (node == NULL)
+	return NULL;
+
+    node->val = val;
+    node->next = NULL;
+    return node;
+}
+
+static void free_enode(void * node)
+{
+    if (use_pool)
+	pool_free(&enode_pool, node);
+    else
+	free(node);
+}
+
+template<class Q>
+Q *init_equeue(void)
+{
+    Q *q;
+    enode_t *node;
+
+    if ((q = (Q *) alloc_queue(sizeof(Q))) == NULL) {
+	return NULL;
+    }
+
+    if ((node = create_enode((val_t)NULL)) == NULL) {
+      abort();
+    }
+
+    q->head = node;
+    q->tail = node;
+
+    return q;
+}
+
+template<class Q>
+bool_t enq_epoch(Q * q, const val_t val)
+{
+    enode_t *newNode, *tail, *next;
+
+    if ((newNode = create_enode(val)) == NULL)
+	return false;
+
+    ebr_enter(&ebr);
+    while (1) {
+	tail = q->tail;
+	next = tail->next;
+
+	if (tail == q->tail) {
+	  if (next == NULL) {
+	    if (ptr_cas(&tail->next, NULL, newNode) == true) {
+	      break;
+	    }
+	  }
+	  else {
+	    ptr_cas(&q->tail, tail, next);
+	  }
+	}
+    }
+    ptr_cas(&q->tail, tail, newNode);
+    ebr_exit(&ebr);
+
+    return true;
+}
+
+template<class Q>
+bool_t deq_epoch(Q * q, val_t * val)
+{
+  enode_t *head, *tail, *next;
+
+    ebr_enter(&ebr);
+    while (1) {
+	head = q->head;
+	tail = q->tail;
+	next = head->next;
+
+	if (head == q->head) {
+	  if (head == tail) {
+	    if (next == NULL) {
+	      ebr_exit(&ebr);
+	      return false;
+	    }
+	    ptr_cas(&q->tail, tail, next);
+	  }
+	  else {
+	    *val = next->val;
+	    if (ptr_cas(&q->head, head, next) == true) {
+	      break;
+	    }
+	  }
+	}
+    }
+    ebr_exit(&ebr);
+
+    //other threads may still be reading head; free it once they cannot be
+    ebr_retire(&ebr, head);
+    return true;
+}
+
+template<class Q>
+bool_t enq_hazard(Q * q, const val_t val)
+{
+    enode_t *newNode, *tail, *next;
+
+    if ((newNode = create_enode(val)) == NULL)
+	return false;
+
+    while (1) {
+	tail = (enode_t *) hp_protect(&hp, 0, (void * volatile *) &q->tail);
+	next = tail->next;
+
+	if (tail == q->tail) {
+	  if (next == NULL) {
+	    if (ptr_cas(&tail->next, NULL, newNode) == true) {
+	      break;
+	    }
+	  }
+	  else {
+	    ptr_cas(&q->tail, tail, next);
+	  }
+	}
+    }
+    ptr_cas(&q->tail, tail, newNode);
+    hp_clear(&hp);
+
+    return true;
+}
+
+template<class Q>
+bool_t deq_hazard(Q * q, val_t * val)
+{
+  enode_t *head, *tail, *next;
+
+    while (1) {
+	head = (enode_t *) hp_protect(&hp, 0, (void * volatile *) &q->head);
+	tail = q->tail;
+	next = head->next;
+	//next is only safe to read through while head is still the head
+	hp_set(&hp, 1, next);
+	if (head != q->head)
+	  continue;
+
+	if (next == NULL) {
+	  hp_clear(&hp);
+	  return false;
+	}
+	if (head == tail) {
+	  ptr_cas(&q->tail, tail, next);
+	}
+	else {
+	  *val = next->val;
+	  if (ptr_cas(&q->head, head, next) == true) {
+	    break;
+	  }
+	}
+    }
+    hp_clear(&hp);
+
+    hp_retire(&hp, head);
+    return true;
+}
+
+//the node array: slots below inode_used have been handed out at least
+//once, and freed ones sit on a tagged stack linked through their next word.
+//It holds INDEX_NODES nodes unless -c says otherwise, far fewer than a
+//run's enqueues, so dequeued slots must come back through the free list
+#define INDEX_NODES 4096
+char *inodes;
+size_t inode_stride;
+unsigned long inode_count;
+volatile unsigned long inode_used = 1;
+volatile ilink_t ifree = ILINK(INIL, 0);
+
+//64-bit loads and stores of a link in one piece, even on 32-bit x86
+static inline ilink_t read_link(volatile ilink_t * p)
+{
+    ilink_t r;
+    mvx(p, &r);
+    return r;
+}
+
+static inline void write_link(volatile ilink_t * p, ilink_t l)
+{
+    mvx(&l, p);
+}
+
+#define INODE(idx)	((inode_t *)(inodes + (size_t)(idx) * inode_stride))
+
+static inline bool_t
+link_cas(volatile ilink_t * addr, ilink_t oldl, ilink_t newl)
+{
+  return casX(addr, &oldl, &newl);
+}
+
+void init_inodes(unsigned long count)
+{
+    //slots are set up when first handed out, so untouched parts of the
+    //array cost nothing
+    inode_count = count;
+    inode_stride = node_bytes(sizeof(inode_t));
+    if (posix_memalign((void **)&inodes, CACHELINE_BYTES, count * inode_stride))
+      abort();
+}
+
+static unsigned int create_inode(const val_t val)
+{
+    ilink_t top, next;
+    unsigned int idx;
+
+    while (1) {
+	top = read_link(&ifree);
+	idx = ILINK_IDX(top);
+	if (idx == INIL) {
+	  //nothing has been freed yet, so take a fresh slot
+	  if (inode_used >= inode_count
+	      || (idx = fai(&inode_used)) >= inode_count)
+	    return INIL;
+	  INODE(idx)->val = val;
+	  write_link(&INODE(idx)->next, ILINK(INIL, 0));
+	  return idx;
+	}
+	next = read_link(&INODE(idx)->next);
+	if (link_cas(&ifree, top, ILINK(ILINK_IDX(next), ILINK_TAG(top) + 1)) == true)
+	  break;
+    }
+
+    INODE(idx)->val = val;
+    next = read_link(&INODE(idx)->next);
+    write_link(&INODE(idx)->next, ILINK(INIL, ILINK_TAG(next) + 1));
+    return idx;
+}
+
+static void free_inode(unsigned int idx)
+{
+    ilink_t top, next;
+
+    next = read_link(&INODE(idx)->next);
+    do {
+	top = read_link(&ifree);
+	write_link(&INODE(idx)->next, ILINK(ILINK_IDX(top), ILINK_TAG(next) + 1));
+    } while (link_cas(&ifree, top, ILINK(idx, ILINK_TAG(top) + 1)) == false);
+}
+
+template<class Q>
+Q *init_iqueue(void)
+{
+    Q *q;
+    unsigned int node;
+
+    if ((q = (Q *) alloc_queue(sizeof(Q))) == NULL) {
+	return NULL;
+    }
+
+    if ((node = create_inode((val_t)NULL)) == INIL) {
+      abort();
+    }
+
+    q->head = ILINK(node, 0);
+    q->tail = ILINK(node, 0);
+
+    return q;
+}
+
+template<class Q>
+bool_t enq_index(Q * q, const val_t val)
+{
+    unsigned int newNode;
+    ilink_t tail, next;
+
+    if ((newNode = create_inode(val)) == INIL)
+	return false;
+
+    while (1) {
+	tail = read_link(&q->tail);
+	next = read_link(&INODE(ILINK_IDX(tail))->next);
+
+	if (tail == read_link(&q->tail)) {
+	  if (ILINK_IDX(next) == INIL) {
+	    if (link_cas(&INODE(ILINK_IDX(tail))->next, next,
+			 ILINK(newNode, ILINK_TAG(next) + 1)) == true) {
+	      break;
+	    }
+	  }
+	  else {
+	    link_cas(&q->tail, tail, ILINK(ILINK_IDX(next), ILINK_TAG(tail) + 1));
+	  }
+	}
+    }
+    link_cas(&q->tail, tail, ILINK(newNode, ILINK_TAG(tail) + 1));
+
+    return true;
+}
+
+template<class Q>
+bool_t deq_index(Q * q, val_t * val)
+{
+  ilink_t head, tail, next;
+
+    while (1) {
+	head = read_link(&q->head);
+	tail = read_link(&q->tail);
+	next = read_link(&INODE(ILINK_IDX(head))->next);
+
+	if (head == read_link(&q->head)) {
+	  if (ILINK_IDX(head) == ILINK_IDX(tail)) {
+	    if (ILINK_IDX(next) == INIL) {
+	      return false;
+	    }
+	    link_cas(&q->tail, tail, ILINK(ILINK_IDX(next), ILINK_TAG(tail) + 1));
+	  }
+	  else {
+	    *val = INODE(ILINK_IDX(next))->val;
+	    if (link_cas(&q->head, head, ILINK(ILINK_IDX(next), ILINK_TAG(head) + 1)) == true) {
+	      break;
+	    }
+	  }
+	}
+    }
+
+    free_inode(ILINK_IDX(head));
+    return true;
+}
+
 void show_queue(queue_t * q)
 {
     node_t *curr;
@@ -199,6 +730,11 @@ void show_queue(queue_t * q)
 }
 
 queue_t *q;
+equeue_t *eq;
+iqueue_t *iq;
+padded_queue_t *pq;
+padded_equeue_t *peq;
+padded_iqueue_t *piq;
 
 int generateProb()
 {
@@ -206,44 +742,156 @@ int generateProb()
 }
 
 
-void *my_loop(void *threadid)
+//one enqueue on the queue of the mode that runs; false if it was refused
+template<class Q, class EQ, class IQ>
+bool_t enq_one(Q *q, EQ *eq, IQ *iq, val_t val)
+{
+    if(reclaim == RECLAIM_RING)
+	return mpmc_enqueue(&ring, val);
+    else if(reclaim == RECLAIM_FAA) {
+	faaq_enqueue(&faaq, val);
+	return true;
+    }
+    else if(reclaim == RECLAIM_EPOCH)
+	return enq_epoch(eq, val);
+    else if(reclaim == RECLAIM_HAZARD)
+	return enq_hazard(eq, val);
+    else if(reclaim == RECLAIM_INDEX)
+	return enq_index(iq, val);
+    return enq(q, val);
+}
+
+//one dequeue; false if the queue was empty
+template<class Q, class EQ, class IQ>
+bool_t deq_one(Q *q, EQ *eq, IQ *iq, val_t *val)
+{
+    if(reclaim == RECLAIM_RING)
+	return mpmc_dequeue(&ring, (unsigned long *)val);
+    else if(reclaim == RECLAIM_FAA)
+	return faaq_dequeue(&faaq, (unsigned long *)val);
+    else if(reclaim == RECLAIM_EPOCH)
+	return deq_epoch(eq, val);
+    else if(reclaim == RECLAIM_HAZARD)
+	return deq_hazard(eq, val);
+    else if(reclaim == RECLAIM_INDEX)
+	return deq_index(iq, val);
+    return deq(q, val);
+}
+
+//one thread's share of the benchmark, on the queues of one layout
+template<class Q, class EQ, class IQ>
+void run_ops(Q *q, EQ *eq, IQ *iq, int prob)
 {
-	int tid;
-   	tid = (int)threadid;
         int i;
-	int prob = generateProb();
  	val_t val;
+	unsigned long full = 0;
+	unsigned long long n_in = 0, n_out = 0, s_in = 0, s_out = 0;
 
  	for(i = 1; i <= iterations; i++) {
-		cout << iterations;
-		cout << "probability: " << prob << endl;
        		 if(prob == 0)
        		 {
-		    cout << "Thread : " << tid << ", Enquing" << iterations << endl;
-        	    enq(q,iterations);
+		    if(enq_one(q, eq, iq, i)) {
+			n_in++;
+			s_in += i;
+		    }
+		    else
+			full++;
        		 }
       		  else if( prob == 1) 
       		  {
-       		     cout << "Thread : " << tid << ", Dequing" << iterations << endl;
- 		    deq(q, &val);
+		    if(deq_one(q, eq, iq, &val)) {
+			n_out++;
+			s_out += val;
+		    }
       		  }
 
 	}
+	if(full)
+		faa(&enq_refused, full);
+	pthread_mutex_lock(&myMutex);
+	items_in += n_in;
+	items_out += n_out;
+	sum_in += s_in;
+	sum_out += s_out;
+	pthread_mutex_unlock(&myMutex);
+}
+
+//dequeue whatever the threads left behind; returns how many items that was
+template<class Q, class EQ, class IQ>
+unsigned long long drain(Q *q, EQ *eq, IQ *iq)
+{
+	val_t val;
+	unsigned long long n = 0;
+
+	while(deq_one(q, eq, iq, &val)) {
+		n++;
+		sum_out += val;
+	}
+	items_out += n;
+	return n;
+}
+
+//one side of a producer/consumer pair.  A full or empty ring is retried,
+//yielding now and then in case the other side is waiting for a processor
+#define PAIR_SPINS 1024
+
+void run_pair(int tid)
+{
+	spsc_ring_t *r = &spsc[tid / 2];
+	unsigned long v;
+	unsigned long long sum = 0;
+	int i;
+	unsigned int tries;
+
+	if(tid % 2 == 0) {
+		for(i = 1; i <= iterations; i++)
+			for(tries = 1; !spsc_enqueue(r, i); tries++)
+				if(tries % PAIR_SPINS == 0)
+					os_yield();
+		spsc_flush(r);
+	}
+	else {
+		for(i = 1; i <= iterations; i++) {
+			for(tries = 1; !spsc_dequeue(r, &v); tries++)
+				if(tries % PAIR_SPINS == 0)
+					os_yield();
+			sum += v;
+		}
+		pair_sum[tid / 2] = sum;
+	}
+}
+
+void *my_loop(void *threadid)
+{
+	int tid;
+   	tid = (int)(long)threadid;
+	int prob = generateProb();
+	if(producers >= 0)
+		prob = tid < producers ? 0 : 1;
+
+	if(reclaim == RECLAIM_SPSC) {
+		run_pair(tid);
+		pthread_exit(NULL);
+	}
+
+	if(layout == LAYOUT_PADDED)
+		run_ops(pq, peq, piq, prob);
+	else
+		run_ops(q, eq, iq, prob);
       
 	pthread_exit(NULL);
 }
 
 int main(int argc, char* argv[])
 {	
-	q = init_queue();
-	
 	//default values for number of threads & iterations	
 	int NUM_THREADS = 4;
 	iterations      = 10000;
 		
 	if(argc <1) 
 	{
-		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter -lpthread" <<std::endl;
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-m tagged|epoch|hazard|index|ring|spsc|faa] [-a malloc|pool] [-l packed|padded] [-c capacity [-p producers]] -lpthread" <<std::endl
+		          << "options are positional: give every one before the last you need; -c 0 keeps the mode's default capacity" << std::endl;
 	return 1;
 	}
 	//Setting the user defined number of threads & iterations
@@ -252,6 +900,109 @@ int main(int argc, char* argv[])
    	NUM_THREADS     = atoi(argv[2]);
 	iterations      = atoi(argv[4]);
 	}
+	if(argc >6)
+	{
+		if(strcmp(argv[6], "epoch") == 0)
+			reclaim = RECLAIM_EPOCH;
+		else if(strcmp(argv[6], "hazard") == 0)
+			reclaim = RECLAIM_HAZARD;
+		else if(strcmp(argv[6], "index") == 0)
+			reclaim = RECLAIM_INDEX;
+		else if(strcmp(argv[6], "ring") == 0)
+			reclaim = RECLAIM_RING;
+		else if(strcmp(argv[6], "spsc") == 0)
+			reclaim = RECLAIM_SPSC;
+		else if(strcmp(argv[6], "faa") == 0)
+			reclaim = RECLAIM_FAA;
+	}
+	if(argc >8)
+		use_pool = (strcmp(argv[8], "pool") == 0);
+	if(argc >10 && strcmp(argv[10], "padded") == 0)
+		layout = LAYOUT_PADDED;
+	//-c 0 stands in for the default when only -p is wanted
+	if(argc >12)
+	{
+		unsigned long long c = strtoull(argv[12], NULL, 10);
+		if(c > RING_MAX_CAPACITY)
+		{
+			std::cerr << "capacity must be 0 (the default) to " << RING_MAX_CAPACITY << std::endl;
+		return 1;
+		}
+		ring_capacity = (unsigned long)c;
+	}
+	//the main thread takes a thread_index() slot too, for the dummy nodes
+	if(NUM_THREADS >= MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS - 1 << " threads" << std::endl;
+	return 1;
+	}
+	//spsc pairs fix each thread's role already, so -p has no meaning there
+	if(argc >14)
+	{
+		char *end;
+		long p = strtol(argv[14], &end, 10);
+		if(reclaim == RECLAIM_SPSC)
+		{
+			std::cerr << "-p does not apply to spsc, which always runs producer/consumer pairs" << std::endl;
+		return 1;
+		}
+		if(*end != '\0' || p < 0 || p > NUM_THREADS)
+		{
+			std::cerr << "producers must be 0 to " << NUM_THREADS << std::endl;
+		return 1;
+		}
+		producers = (int)p;
+	}
+	pool_init(&node_pool, node_bytes(sizeof(node_t)));
+	pool_init(&enode_pool, node_bytes(sizeof(enode_t)));
+	if(layout == LAYOUT_PADDED) {
+		pq = init_queue<padded_queue_t>();
+		peq = init_equeue<padded_equeue_t>();
+	}
+	else {
+		q = init_queue<queue_t>();
+		eq = init_equeue<equeue_t>();
+	}
+	//every enqueue may find the queue growing, plus the dummy and index 0;
+	//the array is the only source of nodes in index mode, so -a is ignored;
+	//slot 0 stands for INIL and is never handed out
+	if(reclaim == RECLAIM_INDEX) {
+		init_inodes((ring_capacity ? ring_capacity : INDEX_NODES) + 1);
+		if(layout == LAYOUT_PADDED)
+			piq = init_iqueue<padded_iqueue_t>();
+		else
+			iq = init_iqueue<iqueue_t>();
+	}
+	//by default the ring holds every enqueue the run can make, like the
+	//unbounded queues; -c makes it smaller, and a full ring pushes back
+	if(reclaim == RECLAIM_RING) {
+		unsigned long long capacity = (unsigned long long)NUM_THREADS * iterations;
+		if(capacity > RING_MAX_CAPACITY)
+			capacity = RING_MAX_CAPACITY;
+		if(ring_capacity)
+			capacity = ring_capacity;
+		mpmc_init(&ring, (unsigned long)capacity);
+	}
+	//an odd thread out would have no partner, so pairs round the count
+	//down to even; each pair's consumer drains as it goes, so a small
+	//ring will do
+	if(reclaim == RECLAIM_SPSC) {
+		if(NUM_THREADS < 2)
+		{
+			std::cerr << "spsc needs at least 2 threads" << std::endl;
+		return 1;
+		}
+		NUM_THREADS &= ~1;
+		unsigned long capacity = ring_capacity ? ring_capacity : 1024;
+		spsc = new spsc_ring_t[NUM_THREADS / 2];
+		pair_sum = new unsigned long long[NUM_THREADS / 2];
+		for( int k = 0; k < NUM_THREADS / 2; k++ )
+			spsc_init(&spsc[k], capacity, SPSC_BATCH);
+	}
+	if(reclaim == RECLAIM_FAA)
+		faaq_init(&faaq);
+	ebr_init(&ebr, free_enode);
+	hp_init(&hp, free_enode);
 	pthread_t threads[NUM_THREADS];
    	int rc;
    	int i;
@@ -268,19 +1019,18 @@ int main(int argc, char* argv[])
    	start = getElapsedTime();
 
 	//creating the threads
-  	 for( i=1; i <= NUM_THREADS; i++ ){
+  	 for( i=0; i < NUM_THREADS; i++ ){
     	  	//cout << "main() : creating thread, " << i << endl;
-    	  	rc = pthread_create(&threads[i], NULL, my_loop, (void *)i );
+    	  	rc = pthread_create(&threads[i], NULL, my_loop, (void *)(long)i );
     	  	if (rc){
      	  	  cout << "Error:unable to create thread," << rc << endl;
        	  	  exit(-1);
    	  	}
  	  }
-	end = getElapsedTime();
 
         // free attribute and wait for the other threads
  	pthread_attr_destroy(&attr);
-   	for( i=1; i <= NUM_THREADS; i++ ){
+   	for( i=0; i < NUM_THREADS; i++ ){
       		rc = pthread_join(threads[i], &status);
       		if (rc){
         	 cout << "Error:unable to join," << rc << endl;
@@ -288,7 +1038,79 @@ int main(int argc, char* argv[])
       		}
      		//cout << "Main: completed thread id :" << i ;
    	}
+	end = getElapsedTime();
 	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)NUM_THREADS * iterations * 1e9 / (end - start) << " ops/sec\n";
+	if(reclaim != RECLAIM_SPSC) {
+		unsigned long long left = layout == LAYOUT_PADDED ? drain(pq, peq, piq) : drain(q, eq, iq);
+		cout << "Items enqueued = " << items_in << ", dequeued = " << items_out
+		     << " (" << left << " drained after the run) : "
+		     << (items_in == items_out && sum_in == sum_out ? "all items consumed once" : "ITEMS LOST OR REPEATED") << endl;
+	}
+	if(reclaim == RECLAIM_TAGGED)
+#ifdef _X86_64_
+		cout << "Counted pointers = cmpxchg16b, " << sizeof(pointer_t) << " bytes\n";
+#else
+		cout << "Counted pointers = cmpxchg8b, " << sizeof(pointer_t) << " bytes\n";
+#endif
+	else if(reclaim == RECLAIM_EPOCH)
+		cout << "Nodes retired but not yet freed = " << ebr_pending(&ebr) << endl;
+	else if(reclaim == RECLAIM_HAZARD)
+		cout << "Nodes retired but not yet freed = " << hp_pending(&hp) << endl;
+	else if(reclaim == RECLAIM_RING)
+		cout << "Ring capacity = " << mpmc_capacity(&ring)
+		     << ", enqueues refused as full = " << enq_refused << endl;
+	else if(reclaim == RECLAIM_FAA)
+		cout << "Segments of " << FAAQ_SEGMENT << " slots linked in = " << faaq.segments
+		     << ", retired but not yet freed = " << ebr_pending(&faaq.ebr) << endl;
+	else if(reclaim == RECLAIM_SPSC) {
+		bool all = true;
+		for( i=0; i < NUM_THREADS / 2; i++ )
+			all = all && pair_sum[i] == (unsigned long long)iterations * (iterations + 1) / 2;
+		cout << NUM_THREADS / 2 << " pairs, ring capacity = " << spsc[0].mask + 1
+		     << ", batch = " << spsc[0].batch << " : "
+		     << (all ? "all items consumed" : "ITEMS LOST") << endl;
+	}
+	else if(reclaim == RECLAIM_INDEX)
+		cout << "Index links = plain 64-bit CAS, " << sizeof(ilink_t) << " bytes; "
+		     << (inode_used < inode_count ? inode_used : inode_count) - 1 << " of " << inode_count - 1 << " nodes of "
+		     << inode_stride << " bytes used, enqueues refused for lack of nodes = " << enq_refused << endl;
+	//the queue and node sizes of the mode that ran
+	size_t queue_size, node_size;
+	if(reclaim == RECLAIM_TAGGED) {
+		queue_size = layout == LAYOUT_PADDED ? sizeof(padded_queue_t) : sizeof(queue_t);
+		node_size = node_bytes(sizeof(node_t));
+	}
+	else if(reclaim == RECLAIM_INDEX) {
+		queue_size = layout == LAYOUT_PADDED ? sizeof(padded_iqueue_t) : sizeof(iqueue_t);
+		node_size = inode_stride;
+	}
+	else if(reclaim == RECLAIM_RING) {
+		//the ring always keeps its two indices apart; a cell is its node
+		queue_size = sizeof(mpmc_ring_t);
+		node_size = sizeof(mpmc_cell_t);
+	}
+	else if(reclaim == RECLAIM_FAA) {
+		//a slot is the unit of the queue, so report one as the node
+		queue_size = sizeof(faa_queue_t);
+		node_size = sizeof(unsigned long);
+	}
+	else if(reclaim == RECLAIM_SPSC) {
+		queue_size = sizeof(spsc_ring_t);
+		node_size = sizeof(unsigned long);
+	}
+	else {
+		queue_size = layout == LAYOUT_PADDED ? sizeof(padded_equeue_t) : sizeof(equeue_t);
+		node_size = node_bytes(sizeof(enode_t));
+	}
+	cout << "Layout = " << (layout == LAYOUT_PADDED ? "padded" : "packed") << ", queue "
+	     << queue_size << " bytes, node " << node_size << " bytes\n";
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	cout << "Peak memory = " << usage.ru_maxrss << " KB\n";
+	if(use_pool)
+		cout << "Pool slabs = " << node_pool.slabs + enode_pool.slabs
+		     << " of " << POOL_SLAB_BYTES << " bytes\n";
         pthread_mutex_destroy(&myMutex);
         pthread_exit(NULL);
 }
@@ -3,7 +3,9 @@
 #include<stdlib.h>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <pthread.h>
+#include "atomic_ops.h"
 #include "hrtime.h"
 
 
@@ -18,50 +20,110 @@ typedef struct __node_t {
  	struct __node_t *next;
  } node_t;
 
- typedef struct __queue_t {
+ //using two locks, for head & tail; each end can have a lock type of
+ //its own, anything with lock() and unlock()
+ template<class HeadLock, class TailLock>
+ struct queue_t {
 	node_t *head;
  	node_t *tail;
-	//using two locks, for head & tail
- 	pthread_mutex_t headLock;
- 	pthread_mutex_t tailLock;
- } queue_t;
+ 	HeadLock headLock;
+ 	TailLock tailLock;
+ };
+
+ //each end with its lock on a cache line of its own, so that enqueuers
+ //and dequeuers do not false-share
+ template<class HeadLock, class TailLock>
+ struct padded_queue_t {
+	node_t *head;
+ 	HeadLock headLock;
+	node_t *tail __attribute__((aligned(CACHELINE_BYTES)));
+ 	TailLock tailLock;
+ } __attribute__((aligned(CACHELINE_BYTES)));
+
+ //pthread_mutex_t behind the same lock()/unlock() interface
+ struct posix_mutex {
+ 	pthread_mutex_t m;
+ 	posix_mutex() { pthread_mutex_init(&m, NULL); }
+ 	void lock() { pthread_mutex_lock(&m); }
+ 	void unlock() { pthread_mutex_unlock(&m); }
+ };
+
+//the lock types each end can use
+enum { LOCK_TATAS, LOCK_TICKET, LOCK_MCS, LOCK_PTHREAD, LOCK_KINDS };
+const char *lock_names[LOCK_KINDS] = { "tatas", "ticket", "mcs", "pthread" };
+int head_lock = LOCK_PTHREAD;
+int tail_lock = LOCK_PTHREAD;
+
+//where nodes come from: malloc (default) or per-thread pools
+bool use_pool = false;
+pool_t node_pool;
+
+//packed (default): the queue ends share a line and nodes sit back to back;
+//padded: each end and each node gets a cache line of its own
+bool padded = false;
+size_t node_bytes = sizeof(node_t);
+
+node_t *new_node() {
+	void *node;
+	if (use_pool)
+		return (node_t *)pool_alloc(&node_pool);
+	if (!padded)
+		return (node_t *)malloc(sizeof(node_t));
+	if (posix_memalign(&node, CACHELINE_BYTES, node_bytes))
+		return NULL;
+	return (node_t *)node;
+}
+
+void delete_node(node_t *node) {
+	if (use_pool)
+		pool_free(&node_pool, node);
+	else
+		free(node);
+}
+
+//the one queue of each type; the locks are set up by their constructors
+template<class Q>
+Q *the_queue() {
+	static Q q;
+	return &q;
+}
 
-	queue_t myQ;
  //intialize queue 
- void Queue_Init(queue_t *q) {
- 	node_t *tmp = (node_t *)malloc(sizeof(node_t));      // Allocate a free node
+ template<class Q>
+ void Queue_Init(Q *q) {
+ 	node_t *tmp = new_node();                            // Allocate a free node
  	tmp->next = NULL;                                    // Make it the only node in the linked list
  	q->head = q->tail = tmp;                             // Both Head and Tail point to it
- 	pthread_mutex_init(&q->headLock, NULL);
- 	pthread_mutex_init(&q->tailLock, NULL);
  }
  //adding to queue
- void Queue_Enqueue(queue_t *q, int value) { 
-	node_t *tmp = (node_t *)malloc(sizeof(node_t));       // Allocate a new node from the free list
+ template<class Q>
+ void Queue_Enqueue(Q *q, int value) { 
+	node_t *tmp = new_node();                             // Allocate a new node from the free list
  	assert(tmp != NULL);
  	tmp->value = value;
  	tmp->next = NULL;                                     // Set next pointer of node to NULL
 	
 	       
-	pthread_mutex_lock(&q->tailLock);                     // Acquire T_lock in order to access Tail
+	q->tailLock.lock();                                   // Acquire T_lock in order to access Tail
  	q->tail->next = tmp;                                  // Link node at the end of the linked list
 	q->tail = tmp;                                        // Swing Tail to node
- 	pthread_mutex_unlock(&q->tailLock);                   //unlock T_lock
+ 	q->tailLock.unlock();                                 //unlock T_lock
  }
 
  //Dequeue
- int Queue_Dequeue(queue_t *q, int *value) {
- 	pthread_mutex_lock(&q->headLock);            // set H_lock in order to access Head
+ template<class Q>
+ int Queue_Dequeue(Q *q, int *value) {
+ 	q->headLock.lock();                          // set H_lock in order to access Head
  	node_t *tmp = q->head;                       // Read Head
  	node_t *newHead = tmp->next;                 // Read next pointer
  	if (newHead == NULL) {                       // Is queue empty?
- 		pthread_mutex_unlock(&q->headLock);  // Release H_lock before return
+ 		q->headLock.unlock();                // Release H_lock before return
  	return -1;                                   // if the queue was empty
  	}
  	*value = newHead->value;                     // Queue not empty.  Read value before release
  	q->head = newHead;                           // Swing Head to next node
- 	pthread_mutex_unlock(&q->headLock);          // Release H_lock
- 	free(tmp);                                   // Free the tmp node
+ 	q->headLock.unlock();                        // Release H_lock
+ 	delete_node(tmp);                            // Free the tmp node
  	return 0;                                    // Queue was'nt empty, dequeue succeeded
  }
 
@@ -71,35 +133,88 @@ int generateProb()
 }
 
 
-void *my_loop(void *threadid)
+//one thread's share of the benchmark, on the queue of one layout
+template<class Q>
+void run_ops(Q *q, int prob)
 {
-	int tid;
-   	tid = (int)threadid;
         int i;
-	int prob = generateProb();
- 	
+	int val;
+
  	for(i = 1; i <= iterations; i++) {
-		cout << iterations;
-		cout << "probability: " << prob << endl;
        		 if(prob == 0)
-       		 {
-		    cout << "Thread : " << tid << ", Enquing" << iterations << endl;
-        	    Queue_Enqueue(&myQ, iterations);
-       		 }
-      		  else if( prob == 1) 
-      		  {
-       		     cout << "Thread : " << tid << ", Dequing" << iterations << endl;
- 		     Queue_Dequeue(&myQ, &iterations);
-      		  }
+        	    Queue_Enqueue(q, i);
+      		 else
+ 		    Queue_Dequeue(q, &val);
+	}
+}
+
+//the queue type picked by -H, -T and -l: its benchmark loop and its size
+void (*run_queue)(int prob);
+size_t queue_bytes;
+
+template<class Q>
+void run_the_queue(int prob)
+{
+	run_ops(the_queue<Q>(), prob);
+}
+
+template<class Q>
+void use_queue()
+{
+	Queue_Init(the_queue<Q>());
+	run_queue = run_the_queue<Q>;
+	queue_bytes = sizeof(Q);
+}
+
+template<class HeadLock, class TailLock>
+void use_layout()
+{
+	if (padded)
+		use_queue<padded_queue_t<HeadLock, TailLock> >();
+	else
+		use_queue<queue_t<HeadLock, TailLock> >();
+}
 
+template<class HeadLock>
+void use_tail_lock(int kind)
+{
+	switch(kind) {
+	case LOCK_TATAS:  use_layout<HeadLock, tatas_mutex>(); break;
+	case LOCK_TICKET: use_layout<HeadLock, ticket_mutex>(); break;
+	case LOCK_MCS:    use_layout<HeadLock, mcs_mutex>(); break;
+	default:          use_layout<HeadLock, posix_mutex>(); break;
+	}
+}
+
+void use_locks(int head, int tail)
+{
+	switch(head) {
+	case LOCK_TATAS:  use_tail_lock<tatas_mutex>(tail); break;
+	case LOCK_TICKET: use_tail_lock<ticket_mutex>(tail); break;
+	case LOCK_MCS:    use_tail_lock<mcs_mutex>(tail); break;
+	default:          use_tail_lock<posix_mutex>(tail); break;
 	}
-      
+}
+
+int lock_kind(const char *name)
+{
+	for(int k = 0; k < LOCK_KINDS; k++)
+		if(strcmp(name, lock_names[k]) == 0)
+			return k;
+	return LOCK_PTHREAD;
+}
+
+void *my_loop(void *)
+{
+	int prob = generateProb();
+
+	run_queue(prob);
+
 	pthread_exit(NULL);
 }
 
 int main(int argc, char* argv[])
 {	
-	Queue_Init(&myQ);
 	
 	//default values for number of threads & iterations	
 	int NUM_THREADS = 4;
@@ -107,7 +222,8 @@ int main(int argc, char* argv[])
 		
 	if(argc <1) 
 	{
-		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter -lpthread" <<std::endl;
+		std::cerr << "Usage: " << argv[0] << " -t no_of_threads -i counter [-a malloc|pool] [-l packed|padded] [-H head_lock] [-T tail_lock] -lpthread" <<std::endl
+		          << "locks: tatas, ticket, mcs, pthread (default)" <<std::endl;
 	return 1;
 	}
 	//Setting the user defined number of threads & iterations
@@ -116,6 +232,24 @@ int main(int argc, char* argv[])
    	NUM_THREADS     = atoi(argv[2]);
 	iterations      = atoi(argv[4]);
 	}
+	if(argc >6)
+		use_pool = (strcmp(argv[6], "pool") == 0);
+	if(argc >8)
+		padded = (strcmp(argv[8], "padded") == 0);
+	if(padded)
+		node_bytes = (sizeof(node_t) + CACHELINE_BYTES - 1) & ~(size_t)(CACHELINE_BYTES - 1);
+	if(argc >10)
+		head_lock = lock_kind(argv[10]);
+	if(argc >12)
+		tail_lock = lock_kind(argv[12]);
+	//the main thread takes a thread_index() slot too, for the dummy node
+	if(NUM_THREADS >= MAX_THREADS)
+	{
+		std::cerr << "at most " << MAX_THREADS - 1 << " threads" << std::endl;
+	return 1;
+	}
+	pool_init(&node_pool, node_bytes);
+	use_locks(head_lock, tail_lock);
 	pthread_t threads[NUM_THREADS];
    	int rc;
    	int i;
@@ -132,19 +266,18 @@ int main(int argc, char* argv[])
    	start = getElapsedTime();
 
 	//creating the threads
-  	 for( i=1; i <= NUM_THREADS; i++ ){
+  	 for( i=0; i < NUM_THREADS; i++ ){
     	  	//cout << "main() : creating thread, " << i << endl;
-    	  	rc = pthread_create(&threads[i], NULL, my_loop, (void *)i );
+    	  	rc = pthread_create(&threads[i], NULL, my_loop, (void *)(long)i );
     	  	if (rc){
      	  	  cout << "Error:unable to create thread," << rc << endl;
        	  	  exit(-1);
    	  	}
  	  }
-	end = getElapsedTime();
 
         // free attribute and wait for the other threads
  	pthread_attr_destroy(&attr);
-   	for( i=1; i <= NUM_THREADS; i++ ){
+   	for( i=0; i < NUM_THREADS; i++ ){
       		rc = pthread_join(threads[i], &status);
       		if (rc){
         	 cout << "Error:unable to join," << rc << endl;
@@ -152,7 +285,12 @@ int main(int argc, char* argv[])
       		}
      		//cout << "Main: completed thread id :" << i ;
    	}
+	end = getElapsedTime();
 	cout << "Execution time =" << (end - start)  <<" nsec\n";
+	cout << "Throughput =" << (double)NUM_THREADS * iterations * 1e9 / (end - start) << " ops/sec\n";
+	cout << "Head lock = " << lock_names[head_lock] << ", tail lock = " << lock_names[tail_lock] << endl;
+	cout << "Layout = " << (padded ? "padded" : "packed") << ", queue "
+	     << queue_bytes << " bytes, node " << node_bytes << " bytes\n";
         pthread_mutex_destroy(&myMutex);
         pthread_exit(NULL);
 }